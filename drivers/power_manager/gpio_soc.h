@@ -0,0 +1,53 @@
+/*
+ * GPIO chip of the Raspberry Pi for the power manager of the Pitendo
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * The GPIOs given as module parameters are offsets on the GPIO chip of the SoC, the BCM numbers. They are mapped to
+ * descriptors with a lookup table on the label of the chip, global GPIO numbers depend on the order the chips were
+ * registered in and start at 512 from Linux 6.6.
+ */
+
+#ifndef POWER_MANAGER_GPIO_SOC_H_
+#define POWER_MANAGER_GPIO_SOC_H_
+
+#include <linux/kernel.h>
+#include <linux/of.h>
+
+/*
+ * Raspberry Pi SoCs and the label of their GPIO chip, most specific first.
+ */
+static const struct {
+	const char *compatible;
+	const char *label;
+} gpio_socs[] = {
+	{ "brcm,bcm2712", "pinctrl-rp1" },
+	{ "brcm,bcm2711", "pinctrl-bcm2711" },
+	{ "brcm,bcm2837", "pinctrl-bcm2835" },
+	{ "brcm,bcm2710", "pinctrl-bcm2835" },
+	{ "brcm,bcm2836", "pinctrl-bcm2835" },
+	{ "brcm,bcm2709", "pinctrl-bcm2835" },
+	{ "brcm,bcm2835", "pinctrl-bcm2835" },
+	{ "brcm,bcm2708", "pinctrl-bcm2835" },
+};
+
+/**
+ * Get the label of the GPIO chip of the SoC.
+ *
+ * @return The label, or NULL if the SoC is not known
+ */
+static inline const char *gpio_soc_label(void) {
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gpio_socs); i++) {
+		if (of_machine_is_compatible(gpio_socs[i].compatible)) {
+			return gpio_socs[i].label;
+		}
+	}
+	return NULL;
+}
+
+#endif /* POWER_MANAGER_GPIO_SOC_H_ */
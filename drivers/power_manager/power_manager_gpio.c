@@ -0,0 +1,238 @@
+/*
+ * Shutdown and halt lines of the power manager of the Pitendo
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * The power manager raises SHUTDOWN_PIN to ask the Pi to shut down and cuts the power once RPI_PIN has been low for
+ * a while. The module powers the Pi off when the shutdown line rises, and holds the alive line high from when it is
+ * loaded until the very end of the power off, after the filesystems have been unmounted and the devices shut down.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/gpio/consumer.h>
+#include <linux/gpio/machine.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/pm.h>
+#include <linux/reboot.h>
+#include <linux/atomic.h>
+#include <linux/version.h>
+#include "gpio_soc.h"
+
+MODULE_AUTHOR("Christian Isaksson");
+MODULE_AUTHOR("Karl Thoren <karl.h.thoren@gmail.com>");
+MODULE_DESCRIPTION("Shutdown and halt lines of the power manager of the Pitendo");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("1.0.0");
+
+static int shutdown_gpio = 6;
+static int alive_gpio = 5;
+
+/**
+ * @brief Definition of module parameter shutdown_gpio. This parameter are readable from the sysfs.
+ */
+module_param(shutdown_gpio, int, S_IRUGO);
+MODULE_PARM_DESC(shutdown_gpio, "BCM number of the GPIO connected to SHUTDOWN_PIN. (6 by default.)");
+
+/**
+ * @brief Definition of module parameter alive_gpio. This parameter are readable from the sysfs.
+ */
+module_param(alive_gpio, int, S_IRUGO);
+MODULE_PARM_DESC(alive_gpio, "BCM number of the GPIO connected to RPI_PIN, must be pulled high at reset. (5 by default.)");
+
+// The GPIOs are requested for this device, through a lookup table on the GPIO chip of the SoC
+static struct platform_device *pdev;
+static struct gpiod_lookup_table *lookup;
+static struct gpio_desc *shutdown_desc;
+static struct gpio_desc *alive_desc;
+static int shutdown_irq;
+static atomic_t shutdown_requested = ATOMIC_INIT(0);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+static struct sys_off_handler *power_off_handler;
+#else
+static void (*old_power_off)(void);
+#endif
+
+/**
+ * Interrupt of the shutdown line. Powers the Pi off, once.
+ *
+ * @param irq The interrupt
+ * @param data Not used
+ * @return IRQ_HANDLED
+ */
+static irqreturn_t power_manager_gpio_irq(int irq, void *data) {
+	if (atomic_xchg(&shutdown_requested, 1) == 0) {
+		pr_info("Shutdown requested by the power manager\n");
+		// Runs poweroff from a work, and powers off without it if it can not be run
+		orderly_poweroff(true);
+	}
+	return IRQ_HANDLED;
+}
+
+/**
+ * Last step of the power off. The alive line goes low and the power manager cuts the power.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+static int power_manager_gpio_power_off(struct sys_off_data *data) {
+	gpiod_set_value(alive_desc, 0);
+	return NOTIFY_DONE;
+}
+#else
+static void power_manager_gpio_power_off(void) {
+	gpiod_set_value(alive_desc, 0);
+	if (old_power_off) {
+		old_power_off();
+	}
+}
+#endif
+
+/**
+ * Init function of the module.
+ *
+ * @return Result of the init operation
+ */
+static int __init power_manager_gpio_init(void) {
+	const char *label;
+	int status;
+
+	if (shutdown_gpio < 0 || alive_gpio < 0 || shutdown_gpio == alive_gpio) {
+		pr_err("Invalid GPIOs, shutdown_gpio %d and alive_gpio %d\n", shutdown_gpio, alive_gpio);
+		return -EINVAL;
+	}
+
+	label = gpio_soc_label();
+	if (!label) {
+		pr_err("Unknown SoC, the GPIOs can not be mapped to its GPIO chip\n");
+		return -ENODEV;
+	}
+
+	pdev = platform_device_register_simple(KBUILD_MODNAME, -1, NULL, 0);
+	if (IS_ERR(pdev)) {
+		return PTR_ERR(pdev);
+	}
+
+	lookup = kzalloc(struct_size(lookup, table, 3), GFP_KERNEL);
+	if (!lookup) {
+		status = -ENOMEM;
+		goto err_pdev;
+	}
+	lookup->dev_id = dev_name(&pdev->dev);
+	lookup->table[0] = GPIO_LOOKUP(label, alive_gpio, "alive", GPIO_ACTIVE_HIGH);
+	lookup->table[1] = GPIO_LOOKUP(label, shutdown_gpio, "shutdown", GPIO_ACTIVE_HIGH);
+	gpiod_add_lookup_table(lookup);
+
+	// The Pi is alive from here on until it has been powered off
+	alive_desc = gpiod_get(&pdev->dev, "alive", GPIOD_OUT_HIGH);
+	if (IS_ERR(alive_desc)) {
+		pr_err("Could not request GPIO %d, it may be used by another driver\n", alive_gpio);
+		status = PTR_ERR(alive_desc);
+		goto err_lookup;
+	}
+
+	shutdown_desc = gpiod_get(&pdev->dev, "shutdown", GPIOD_IN);
+	if (IS_ERR(shutdown_desc)) {
+		pr_err("Could not request GPIO %d, it may be used by another driver\n", shutdown_gpio);
+		status = PTR_ERR(shutdown_desc);
+		goto err_alive;
+	}
+
+	shutdown_irq = gpiod_to_irq(shutdown_desc);
+	if (shutdown_irq < 0) {
+		pr_err("GPIO %d has no interrupt\n", shutdown_gpio);
+		status = shutdown_irq;
+		goto err_shutdown;
+	}
+
+	// Before the default handlers, which halt the SoC
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+	power_off_handler = register_sys_off_handler(SYS_OFF_MODE_POWER_OFF, SYS_OFF_PRIO_HIGH,
+			power_manager_gpio_power_off, NULL);
+	if (IS_ERR(power_off_handler)) {
+		pr_err("Could not register the power off handler\n");
+		status = PTR_ERR(power_off_handler);
+		goto err_shutdown;
+	}
+#else
+	old_power_off = pm_power_off;
+	pm_power_off = power_manager_gpio_power_off;
+#endif
+
+	status = request_irq(shutdown_irq, power_manager_gpio_irq, IRQF_TRIGGER_RISING, KBUILD_MODNAME, NULL);
+	if (status != 0) {
+		pr_err("Could not request interrupt %d\n", shutdown_irq);
+		goto err_power_off;
+	}
+
+	// A shutdown requested before the module was loaded has no edge left
+	if (gpiod_get_value(shutdown_desc)) {
+		power_manager_gpio_irq(shutdown_irq, NULL);
+	}
+
+	pr_info("Shutdown line on GPIO %d, alive line on GPIO %d of %s\n", shutdown_gpio, alive_gpio, label);
+	return 0;
+
+err_power_off:
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+	unregister_sys_off_handler(power_off_handler);
+#else
+	pm_power_off = old_power_off;
+#endif
+err_shutdown:
+	gpiod_put(shutdown_desc);
+err_alive:
+	gpiod_put(alive_desc);
+err_lookup:
+	gpiod_remove_lookup_table(lookup);
+	kfree(lookup);
+err_pdev:
+	platform_device_unregister(pdev);
+	return status;
+}
+
+/**
+ * Exit function of the module. The alive line is released, its pull-up keeps it high so the Pi stays powered.
+ */
+static void __exit power_manager_gpio_exit(void) {
+	free_irq(shutdown_irq, NULL);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+	unregister_sys_off_handler(power_off_handler);
+#else
+	if (pm_power_off == power_manager_gpio_power_off) {
+		pm_power_off = old_power_off;
+	}
+#endif
+	gpiod_put(shutdown_desc);
+	gpiod_put(alive_desc);
+	gpiod_remove_lookup_table(lookup);
+	kfree(lookup);
+	platform_device_unregister(pdev);
+}
+
+module_init(power_manager_gpio_init);
+module_exit(power_manager_gpio_exit);
@@ -0,0 +1,483 @@
+/*
+ * I2C client for the power manager of the Pitendo
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/i2c.h>
+#include <linux/interrupt.h>
+#include <linux/gpio/consumer.h>
+#include <linux/gpio/machine.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/of.h>
+#include <linux/version.h>
+#include "gpio_soc.h"
+
+MODULE_AUTHOR("Christian Isaksson");
+MODULE_AUTHOR("Karl Thoren <karl.h.thoren@gmail.com>");
+MODULE_DESCRIPTION("I2C client for the power manager of the Pitendo");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("1.0.0");
+
+// Registers of the power manager, see firmware/attiny24a/power_manager.h
+#define REG_STATE 0x00
+#define REG_REASON 0x01
+#define REG_COMMAND 0x02
+#define REG_PRESSED_DEBOUNCE 0x03
+#define REG_RELEASED_DEBOUNCE 0x04
+#define REG_HARD_POWER_OFF_DELAY 0x05
+#define REG_POWER_OFF_DELAY 0x07
+#define REG_SHUTDOWN_TIMEOUT 0x09
+#define REG_POWER_CYCLE_DELAY 0x0B
+#define REG_ID 0x0D
+#define REG_SUPPLY 0x0E
+#define REG_SUPPLY_THRESHOLD 0x10
+
+#define I2C_ID 0x50
+#define STATE_SHUTDOWN_REQUESTED 0x80
+#define STATE_SUPPLY_LOW 0x40
+#define STATE_MASK 0x3F
+#define COMMAND_POWER_CYCLE 0x01
+#define COMMAND_CANCEL 0x02
+
+static const char * const state_names[] = {"off", "booting", "running", "halting"};
+static const char * const reason_names[] = {"none", "halted", "hard_power_off", "timeout", "undervoltage"};
+
+/*
+ * Structure that contain the state of the client.
+ */
+struct power_manager {
+	struct i2c_client *client;
+	struct mutex lock;	// Serializes transfers that span several registers.
+	unsigned long shutdown_requests;	// Number of shutdown requests signalled by the interrupt.
+	int irq;
+	struct gpio_desc *shutdown;	// Shutdown line when the device tree gives no interrupt, otherwise NULL.
+};
+
+/*
+ * A register exposed as a sysfs attribute, in ms or mV.
+ */
+struct power_manager_attribute {
+	struct device_attribute attr;
+	u8 reg;
+	u8 size;	// 1 or 2 bytes, little endian
+};
+
+#define to_pm_attr(a) container_of(a, struct power_manager_attribute, attr)
+
+static int shutdown_gpio = -1;
+
+/**
+ * @brief Definition of module parameter shutdown_gpio. This parameter are readable from the sysfs.
+ */
+module_param(shutdown_gpio, int, S_IRUGO);
+MODULE_PARM_DESC(shutdown_gpio, "BCM number of the GPIO connected to SHUTDOWN_PIN, used when the device tree gives no interrupt or shutdown-gpios. (-1, no interrupt, by default.)");
+
+/**
+ * Read a register.
+ *
+ * @param pm The client
+ * @param reg Register
+ * @param size Size of the register in bytes
+ * @return Value of the register, or a negative error code
+ */
+static int pm_read(struct power_manager *pm, u8 reg, u8 size) {
+	if (size == 2) {
+		return i2c_smbus_read_word_data(pm->client, reg);
+	}
+	return i2c_smbus_read_byte_data(pm->client, reg);
+}
+
+/**
+ * Write a register.
+ *
+ * @param pm The client
+ * @param reg Register
+ * @param size Size of the register in bytes
+ * @param val Value to write
+ * @return Status
+ */
+static int pm_write(struct power_manager *pm, u8 reg, u8 size, u16 val) {
+	if (size == 2) {
+		return i2c_smbus_write_word_data(pm->client, reg, val);
+	}
+	return i2c_smbus_write_byte_data(pm->client, reg, val);
+}
+
+/**
+ * Show function for the sysfs attributes of the timing registers.
+ */
+static ssize_t timing_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	struct power_manager_attribute *pm_attr = to_pm_attr(attr);
+	int val;
+
+	mutex_lock(&pm->lock);
+	val = pm_read(pm, pm_attr->reg, pm_attr->size);
+	mutex_unlock(&pm->lock);
+
+	if (val < 0) {
+		return val;
+	}
+	return sprintf(buf, "%d\n", val);
+}
+
+/**
+ * Store function for the sysfs attributes of the timing registers.
+ */
+static ssize_t timing_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	struct power_manager_attribute *pm_attr = to_pm_attr(attr);
+	unsigned int val;
+	int status;
+
+	status = kstrtouint(buf, 0, &val);
+	if (status != 0) {
+		return status;
+	}
+	if (val > (pm_attr->size == 2 ? U16_MAX : U8_MAX)) {
+		return -ERANGE;
+	}
+
+	mutex_lock(&pm->lock);
+	status = pm_write(pm, pm_attr->reg, pm_attr->size, val);
+	mutex_unlock(&pm->lock);
+
+	return status ? status : count;
+}
+
+#define PM_TIMING_ATTR(_name, _reg, _size) \
+	struct power_manager_attribute dev_attr_##_name = { \
+		.attr = __ATTR(_name, S_IRUGO | S_IWUSR, timing_show, timing_store), \
+		.reg = _reg, \
+		.size = _size, \
+	}
+
+static PM_TIMING_ATTR(pressed_debounce_ms, REG_PRESSED_DEBOUNCE, 1);
+static PM_TIMING_ATTR(released_debounce_ms, REG_RELEASED_DEBOUNCE, 1);
+static PM_TIMING_ATTR(hard_power_off_ms, REG_HARD_POWER_OFF_DELAY, 2);
+static PM_TIMING_ATTR(power_off_delay_ms, REG_POWER_OFF_DELAY, 2);
+static PM_TIMING_ATTR(shutdown_timeout_ms, REG_SHUTDOWN_TIMEOUT, 2);
+static PM_TIMING_ATTR(power_cycle_delay_ms, REG_POWER_CYCLE_DELAY, 2);
+static PM_TIMING_ATTR(supply_threshold_mv, REG_SUPPLY_THRESHOLD, 2);
+
+/**
+ * Show function for the sysfs attribute state. State of the Pi as seen by the power manager.
+ */
+static ssize_t state_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	int state;
+
+	state = pm_read(pm, REG_STATE, 1);
+	if (state < 0) {
+		return state;
+	}
+	state &= STATE_MASK;
+	return sprintf(buf, "%s\n", state < ARRAY_SIZE(state_names) ? state_names[state] : "unknown");
+}
+
+static DEVICE_ATTR_RO(state);
+
+/**
+ * Show function for the sysfs attribute reason. Reason of the last power off.
+ */
+static ssize_t reason_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	int reason;
+
+	reason = pm_read(pm, REG_REASON, 1);
+	if (reason < 0) {
+		return reason;
+	}
+	return sprintf(buf, "%s\n", reason < ARRAY_SIZE(reason_names) ? reason_names[reason] : "unknown");
+}
+
+static DEVICE_ATTR_RO(reason);
+
+/**
+ * Show function for the sysfs attribute shutdown_requested. Reads 1 while the power manager asks the Pi to shut down,
+ * can be polled for changes.
+ */
+static ssize_t shutdown_requested_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	int state;
+
+	state = pm_read(pm, REG_STATE, 1);
+	if (state < 0) {
+		return state;
+	}
+	return sprintf(buf, "%d\n", !!(state & STATE_SHUTDOWN_REQUESTED));
+}
+
+static DEVICE_ATTR_RO(shutdown_requested);
+
+/**
+ * Show function for the sysfs attribute shutdown_requests. Number of shutdown requests signalled by the interrupt.
+ */
+static ssize_t shutdown_requests_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu\n", READ_ONCE(pm->shutdown_requests));
+}
+
+static DEVICE_ATTR_RO(shutdown_requests);
+
+/**
+ * Show function for the sysfs attribute supply_mv. Last sample of the supply, 0 while the Pi is off.
+ */
+static ssize_t supply_mv_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	int supply;
+
+	supply = pm_read(pm, REG_SUPPLY, 2);
+	if (supply < 0) {
+		return supply;
+	}
+	return sprintf(buf, "%d\n", supply);
+}
+
+static DEVICE_ATTR_RO(supply_mv);
+
+/**
+ * Store function for the sysfs attribute power_cycle. Write 1 to have the Pi powered on again power_cycle_delay_ms
+ * after it has halted, 0 to cancel.
+ */
+static ssize_t power_cycle_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct power_manager *pm = dev_get_drvdata(dev);
+	bool cycle;
+	int status;
+
+	status = kstrtobool(buf, &cycle);
+	if (status != 0) {
+		return status;
+	}
+
+	status = pm_write(pm, REG_COMMAND, 1, cycle ? COMMAND_POWER_CYCLE : COMMAND_CANCEL);
+	return status ? status : count;
+}
+
+static DEVICE_ATTR_WO(power_cycle);
+
+static struct attribute *power_manager_attrs[] = {
+	&dev_attr_state.attr,
+	&dev_attr_reason.attr,
+	&dev_attr_shutdown_requested.attr,
+	&dev_attr_shutdown_requests.attr,
+	&dev_attr_power_cycle.attr,
+	&dev_attr_supply_mv.attr,
+	&dev_attr_pressed_debounce_ms.attr.attr,
+	&dev_attr_released_debounce_ms.attr.attr,
+	&dev_attr_hard_power_off_ms.attr.attr,
+	&dev_attr_power_off_delay_ms.attr.attr,
+	&dev_attr_shutdown_timeout_ms.attr.attr,
+	&dev_attr_power_cycle_delay_ms.attr.attr,
+	&dev_attr_supply_threshold_mv.attr.attr,
+	NULL,
+};
+
+ATTRIBUTE_GROUPS(power_manager);
+
+/**
+ * Interrupt of the shutdown line. Confirms the request with the state register and notifies userspace, with a poll
+ * event on shutdown_requested and a change uevent.
+ *
+ * @param irq The interrupt
+ * @param data The client
+ * @return IRQ_HANDLED if a shutdown was requested
+ */
+static irqreturn_t power_manager_irq(int irq, void *data) {
+	struct power_manager *pm = data;
+	char *envp[] = {"POWER_MANAGER_EVENT=shutdown_request", NULL, NULL};
+	int state;
+
+	state = pm_read(pm, REG_STATE, 1);
+	if (state < 0 || !(state & STATE_SHUTDOWN_REQUESTED)) {
+		return IRQ_NONE;
+	}
+
+	pm->shutdown_requests++;
+	if (state & STATE_SUPPLY_LOW) {
+		envp[1] = "POWER_MANAGER_SUPPLY=low";
+		dev_warn(&pm->client->dev, "Shutdown requested, the supply is low\n");
+	} else {
+		dev_info(&pm->client->dev, "Shutdown requested\n");
+	}
+	sysfs_notify(&pm->client->dev.kobj, NULL, "shutdown_requested");
+	kobject_uevent_env(&pm->client->dev.kobj, KOBJ_CHANGE, envp);
+
+	return IRQ_HANDLED;
+}
+
+/**
+ * Get the shutdown line from the device tree, shutdown-gpios, or from the shutdown_gpio parameter.
+ *
+ * @param pm The client
+ * @return The line, NULL if there is none, or an error pointer
+ */
+static struct gpio_desc *power_manager_get_gpio(struct power_manager *pm) {
+	struct device *dev = &pm->client->dev;
+	struct gpiod_lookup_table *lookup;
+	struct gpio_desc *desc;
+	const char *label;
+
+	if (shutdown_gpio < 0) {
+		return devm_gpiod_get_optional(dev, "shutdown", GPIOD_IN);
+	}
+
+	label = gpio_soc_label();
+	if (!label) {
+		dev_err(dev, "Unknown SoC, shutdown_gpio can not be mapped to its GPIO chip\n");
+		return ERR_PTR(-ENODEV);
+	}
+
+	// Only needed for the lookup, the descriptor stays requested
+	lookup = kzalloc(struct_size(lookup, table, 2), GFP_KERNEL);
+	if (!lookup) {
+		return ERR_PTR(-ENOMEM);
+	}
+	lookup->dev_id = dev_name(dev);
+	lookup->table[0] = GPIO_LOOKUP(label, shutdown_gpio, "shutdown", GPIO_ACTIVE_HIGH);
+	gpiod_add_lookup_table(lookup);
+	desc = devm_gpiod_get_optional(dev, "shutdown", GPIOD_IN);
+	gpiod_remove_lookup_table(lookup);
+	kfree(lookup);
+
+	if (IS_ERR(desc)) {
+		dev_err(dev, "Could not request GPIO %d, it may be used by another driver\n", shutdown_gpio);
+	}
+	return desc;
+}
+
+/**
+ * Get the interrupt of the shutdown line, from the interrupts of the device tree or from the shutdown line.
+ *
+ * @param pm The client
+ * @return The interrupt, 0 if there is none, or a negative error code
+ */
+static int power_manager_get_irq(struct power_manager *pm) {
+	if (pm->client->irq > 0) {
+		return pm->client->irq;
+	}
+
+	pm->shutdown = power_manager_get_gpio(pm);
+	if (IS_ERR(pm->shutdown)) {
+		return PTR_ERR(pm->shutdown);
+	}
+	if (!pm->shutdown) {
+		return 0;
+	}
+	return gpiod_to_irq(pm->shutdown);
+}
+
+/**
+ * Probe function for the client. Checks the id of the power manager and sets up the interrupt.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+static int power_manager_probe(struct i2c_client *client) {
+#else
+static int power_manager_probe(struct i2c_client *client, const struct i2c_device_id *id) {
+#endif
+	struct power_manager *pm;
+	int status;
+
+	status = i2c_smbus_read_byte_data(client, REG_ID);
+	if (status != I2C_ID) {
+		dev_err(&client->dev, "No power manager found, id %d\n", status);
+		return -ENODEV;
+	}
+
+	pm = devm_kzalloc(&client->dev, sizeof(*pm), GFP_KERNEL);
+	if (!pm) {
+		return -ENOMEM;
+	}
+	pm->client = client;
+	mutex_init(&pm->lock);
+	i2c_set_clientdata(client, pm);
+
+	pm->irq = power_manager_get_irq(pm);
+	if (pm->irq < 0) {
+		return pm->irq;
+	}
+
+	if (pm->irq > 0) {
+		status = request_threaded_irq(pm->irq, NULL, power_manager_irq, IRQF_TRIGGER_RISING | IRQF_ONESHOT,
+				KBUILD_MODNAME, pm);
+		if (status != 0) {
+			dev_err(&client->dev, "Could not request interrupt %d\n", pm->irq);
+			return status;
+		}
+	} else {
+		dev_info(&client->dev, "No interrupt for the shutdown line, shutdown requests are not signalled\n");
+	}
+
+	dev_info(&client->dev, "Power manager found\n");
+	return 0;
+}
+
+/**
+ * Remove function for the client.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+static void power_manager_remove(struct i2c_client *client) {
+#else
+static int power_manager_remove(struct i2c_client *client) {
+#endif
+	struct power_manager *pm = i2c_get_clientdata(client);
+
+	if (pm->irq > 0) {
+		free_irq(pm->irq, pm);
+	}
+	mutex_destroy(&pm->lock);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 1, 0)
+	return 0;
+#endif
+}
+
+static const struct i2c_device_id power_manager_id[] = {
+	{"power_manager", 0},
+	{}
+};
+MODULE_DEVICE_TABLE(i2c, power_manager_id);
+
+static const struct of_device_id power_manager_of_match[] = {
+	{.compatible = "pitendo,power-manager"},
+	{}
+};
+MODULE_DEVICE_TABLE(of, power_manager_of_match);
+
+static struct i2c_driver power_manager_driver = {
+	.driver = {
+		.name = KBUILD_MODNAME,
+		.of_match_table = power_manager_of_match,
+		.dev_groups = power_manager_groups,
+	},
+	.probe = power_manager_probe,
+	.remove = power_manager_remove,
+	.id_table = power_manager_id,
+};
+
+module_i2c_driver(power_manager_driver);
@@ -0,0 +1,140 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/init.h>
+#include <linux/ioport.h>
+#include <asm/io.h>
+#include "gpio.h"
+#include "gpio_regs.h"
+
+/* _____ _____ _____ ____
+  / ____|  __ \_   _/ __ \ 
+ | |  __| |__) || || |  | |
+ | | |_ |  ___/ | || |  | |
+ | |__| | |    _| || |__| |
+  \_____|_|   |_____\____/                            
+*/
+
+const char gpio_backend[] = "registers";
+const bool gpio_atomic_direction = true;
+
+static volatile unsigned *gpio;	// I/O access.
+static const struct gpio_soc *soc;
+
+/**
+ * Set GPIO high.
+ *
+ * @param g_bit GPIO
+ */
+void gpio_set(unsigned int g_bit) {
+	*(gpio + GPSET) = g_bit;
+}
+
+/**
+ * Set GPIO low.
+ *
+ * @param g_bit GPIO
+ */
+void gpio_clear(unsigned int g_bit) {
+	*(gpio + GPCLR) = g_bit;
+}
+
+/**
+ * Set GPIOs as input
+ *
+ * @param g_bit GPIOs
+ */
+void gpio_input(unsigned int g_bit) {
+	gpio_regs_input(gpio, g_bit);
+}
+
+/**
+ * Set GPIOs as output, driven at the level they were last set to.
+ *
+ * @param g_bit GPIOs
+ */
+void gpio_output(unsigned int g_bit) {
+	gpio_regs_output(gpio, g_bit);
+}
+
+/**
+ * Activate internal pull-up.
+ * 
+ * @param g_bit GPIO
+ */
+void gpio_enable_pull_up(unsigned int g_bit) {
+	gpio_regs_pull_up(gpio, g_bit, soc->pull_2711);
+}
+
+/**
+ * Read status of GPIO.
+ *
+ * @param g_bit GPIO
+ * @return 1 if the GPIO is high, otherwise 0
+ */
+unsigned char gpio_read(unsigned int g_bit) {
+	return !!(g_bit & *(gpio + GPLEV));
+}
+
+/**
+ * Read and negate status of all GPIOs.
+ *
+ * @return Negated status of all GPIOs
+ */
+unsigned int gpio_read_all(void) {
+	return ~(*(gpio + GPLEV));
+}
+
+/**
+ * Init function for the gpio part of the driver.
+ *
+ * @param g_ids The GPIOs used by the driver
+ * @param n Number of GPIOs
+ * @return Result of the init operation
+ */
+int gpio_init(const unsigned int *g_ids, unsigned char n) {
+	soc = gpio_soc_detect();
+	if (!soc) {
+		return -ENODEV;
+	}
+
+	// Set up gpio pointer for direct register access.
+	if ((gpio = ioremap(soc->peri_base + GPIO_OFFSET, GPIO_SIZE)) == NULL) {
+		pr_err("io remap failed\n");
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+/**
+ * Exit function for the gpio part of the driver.
+ */
+void gpio_exit(void) {
+	iounmap(gpio);
+}
@@ -0,0 +1,51 @@
+/*
+ * GPIO access for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * The pads only reach the GPIOs through these functions, so the backend can be replaced. gpio.c accesses the
+ * registers directly, gpio_desc.c goes through the GPIO descriptor API (make GPIO_BACKEND=gpiod).
+ * The host build in host/ links a simulated bus in their place and lib/ /dev/gpiomem.
+ *
+ * All functions except gpio_valid and gpio_list_valid take GPIOs as bits in the GPIO register, see gpio_get_bit.
+ * gpio_set, gpio_clear and gpio_read_all are called from the timers. gpio_input and gpio_output are too, to detect
+ * SNES Multitaps, unless the backend clears gpio_atomic_direction. gpio_set and gpio_clear also apply to inputs, and
+ * gpio_output drives the GPIOs at the level they were last set to, like the output register of the SoC.
+ */
+
+#ifndef SNESCON_GPIO_H_
+#define SNESCON_GPIO_H_
+
+/*
+ * A Raspberry Pi SoC.
+ */
+struct gpio_soc {
+	const char *compatible;	// Compatible string of the SoC in the device tree
+	unsigned long peri_base;	// Physical address of the peripherals
+	const char *label;	// Label of the GPIO chip
+	bool pull_2711;	// The pull-ups are set like on the BCM2711
+};
+
+extern const char gpio_backend[];	// Name of the backend
+extern const bool gpio_atomic_direction;	// gpio_input and gpio_output can be called from the timers
+
+void gpio_set(unsigned int g_bit);
+void gpio_clear(unsigned int g_bit);
+void gpio_input(unsigned int g_bit);
+void gpio_output(unsigned int g_bit);
+void gpio_enable_pull_up(unsigned int g_bit);
+unsigned char gpio_read(unsigned int g_bit);
+unsigned int gpio_read_all(void);
+int gpio_init(const unsigned int *g_ids, unsigned char n);
+void gpio_exit(void);
+
+// gpio_common.c, shared by the backends
+const struct gpio_soc *gpio_soc_detect(void);
+unsigned char gpio_valid(unsigned int g_id);
+unsigned char gpio_list_valid(const unsigned int *list, unsigned char len);
+unsigned int gpio_get_bit(unsigned char g_id);
+
+#endif /* SNESCON_GPIO_H_ */
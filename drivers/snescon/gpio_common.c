@@ -0,0 +1,115 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/of.h>
+#include "gpio.h"
+
+/*
+ * Raspberry Pi SoCs, most specific first. The peripheral base and the GPIO chip moved between them, so the SoC is
+ * detected from the device tree rather than fixed at build time.
+ */
+static const struct gpio_soc gpio_socs[] = {
+	{ "brcm,bcm2711", 0xFE000000, "pinctrl-bcm2711", true },
+	{ "brcm,bcm2837", 0x3F000000, "pinctrl-bcm2835", false },
+	{ "brcm,bcm2710", 0x3F000000, "pinctrl-bcm2835", false },
+	{ "brcm,bcm2836", 0x3F000000, "pinctrl-bcm2835", false },
+	{ "brcm,bcm2709", 0x3F000000, "pinctrl-bcm2835", false },
+	{ "brcm,bcm2835", 0x20000000, "pinctrl-bcm2835", false },
+	{ "brcm,bcm2708", 0x20000000, "pinctrl-bcm2835", false },
+};
+
+/*
+ * All valid GPIOs found on the Raspberry Pi P1 Header.
+ */
+static const unsigned char all_valid_gpio[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
+
+/**
+ * Calculate the bit in the GPIO register that a specific GPIO number corresponds to.
+ * 
+ * @param g_id The GPIO number
+ * @return The bit that GPIO g corresponds to in the GPIO register
+ */
+unsigned int gpio_get_bit(unsigned char g_id) {
+	return 1 << g_id;
+}
+
+/**
+ * Detect the SoC the driver runs on.
+ *
+ * @return The SoC, or NULL if it is not supported
+ */
+const struct gpio_soc *gpio_soc_detect(void) {
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gpio_socs); i++) {
+		if (of_machine_is_compatible(gpio_socs[i].compatible)) {
+			pr_info("Detected %s\n", gpio_socs[i].compatible);
+			return &gpio_socs[i];
+		}
+	}
+
+	pr_err("Unsupported SoC, the GPIO of the BCM2835, BCM2836, BCM2837 and BCM2711 are supported\n");
+	return NULL;
+}
+
+/**
+ * Check if a GPIO number is valid.
+ * 
+ * @param g_id GPIO number to test validness of
+ * @return 1 if g is valid, otherwise 0
+ */
+unsigned char gpio_valid(unsigned int g_id) {
+	const int len = sizeof(all_valid_gpio) / sizeof(all_valid_gpio[0]);
+	int i;
+
+	for(i = 0; i < len; i++) {
+		if(g_id == all_valid_gpio[i]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Check if all GPIOs in the list are valid.
+ * 
+ * @param list List of GPIO id:s
+ * @param len Length of list
+ * @return 1 if all GPIOs in list is valid, otherwise 0
+ */
+unsigned char gpio_list_valid(const unsigned int *list, unsigned char len) {
+	int i;
+	// Check that all GPIO id:s are valid
+	for(i = 0; i < len; i++) {
+		if(!gpio_valid(list[i])) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,291 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/version.h>
+#include <linux/platform_device.h>
+#include <linux/gpio/consumer.h>
+#include <linux/gpio/machine.h>
+#include <linux/pinctrl/pinconf-generic.h>
+#include "gpio.h"
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 0, 0)
+#error "The gpiod backend needs kernel 5.0 or newer"
+#endif
+
+/* _____ _____ _____ ____      _
+  / ____|  __ \_   _/ __ \    | |
+ | |  __| |__) || || |  | | __| |
+ | | |_ |  ___/ | || |  | |/ _` |
+ | |__| | |    _| || |__| | (_| |
+  \_____|_|   |_____\____/ \__,_|
+*/
+
+/*
+ * GPIO backend built on the GPIO descriptor API. The GPIOs are requested from the GPIO chip of the SoC, so other
+ * drivers can not claim them, and all accesses go through gpiolib, so it does not race with other users of the chip.
+ *
+ * The GPIOs are still addressed as bits in the GPIO register. They are requested once as an array, and every set,
+ * clear and read is one gpiod_*_array_value call on that array with its array_info, which gpiolib uses to access
+ * the lines in one go when their offsets on the chip allow it. Otherwise, and as the chip of the Raspberry Pi has no
+ * set_multiple or get_multiple, gpiolib still accesses the lines one at a time. A set or clear writes the levels of
+ * all lines, the others at the level they were last set to.
+ *
+ * The direction of a line is changed with gpiod_direction_*, which is not called from the timers. The SNES Multitaps
+ * are detected between the reads instead, see gpio_atomic_direction.
+ */
+
+#define MAX_LINES 8
+
+const char gpio_backend[] = "gpiod";
+const bool gpio_atomic_direction = false;
+
+static struct platform_device *pdev;	// Device the GPIOs are requested for.
+static struct gpiod_lookup_table *lookup;
+static struct gpio_descs *lines;	// The GPIOs in the order of the gpio parameter.
+static unsigned int line_bit[MAX_LINES];
+static unsigned long line_values;	// Level last set of every line, bit i for line i.
+
+/**
+ * Get the lines of the GPIOs in a mask.
+ *
+ * @param g_bit GPIOs
+ * @return Lines, bit i for line i
+ */
+static unsigned long gpio_lines(unsigned int g_bit) {
+	unsigned long mask = 0;
+	unsigned int i;
+
+	for (i = 0; i < lines->ndescs; i++) {
+		if (g_bit & line_bit[i]) {
+			mask |= BIT(i);
+		}
+	}
+	return mask;
+}
+
+/**
+ * Set GPIOs to the same level with one array call.
+ *
+ * @param g_bit GPIOs
+ * @param value The level
+ */
+static void gpio_write(unsigned int g_bit, int value) {
+	unsigned long mask = gpio_lines(g_bit);
+
+	if (value) {
+		line_values |= mask;
+	} else {
+		line_values &= ~mask;
+	}
+	gpiod_set_raw_array_value(lines->ndescs, lines->desc, lines->info, &line_values);
+}
+
+/**
+ * Set GPIO high.
+ *
+ * @param g_bit GPIO
+ */
+void gpio_set(unsigned int g_bit) {
+	gpio_write(g_bit, 1);
+}
+
+/**
+ * Set GPIO low.
+ *
+ * @param g_bit GPIO
+ */
+void gpio_clear(unsigned int g_bit) {
+	gpio_write(g_bit, 0);
+}
+
+/**
+ * Set GPIOs as input
+ *
+ * @param g_bit GPIOs
+ */
+void gpio_input(unsigned int g_bit) {
+	unsigned int i;
+
+	for (i = 0; i < lines->ndescs; i++) {
+		if (g_bit & line_bit[i]) {
+			gpiod_direction_input(lines->desc[i]);
+		}
+	}
+}
+
+/**
+ * Set GPIOs as output, driven at the level they were last set to, like the output register keeps it.
+ *
+ * @param g_bit GPIOs
+ */
+void gpio_output(unsigned int g_bit) {
+	unsigned int i;
+
+	for (i = 0; i < lines->ndescs; i++) {
+		if (g_bit & line_bit[i]) {
+			gpiod_direction_output_raw(lines->desc[i], !!(line_values & BIT(i)));
+		}
+	}
+}
+
+/**
+ * Activate internal pull-up. Needs kernel 5.8 or newer, older kernels must set the pull-ups in the device tree.
+ * 
+ * @param g_bit GPIO
+ */
+void gpio_enable_pull_up(unsigned int g_bit) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+	unsigned int i;
+
+	for (i = 0; i < lines->ndescs; i++) {
+		if (!(g_bit & line_bit[i])) {
+			continue;
+		}
+		if (gpiod_set_config(lines->desc[i], pinconf_to_config_packed(PIN_CONFIG_BIAS_PULL_UP, 1)) != 0) {
+			pr_warn("Could not enable pull-up, set it in the device tree\n");
+		}
+	}
+#else
+	pr_warn("Pull-ups can not be set on this kernel, set them in the device tree\n");
+#endif
+}
+
+/**
+ * Read status of GPIO.
+ *
+ * @param g_bit GPIO
+ * @return 1 if the GPIO is high, otherwise 0
+ */
+unsigned char gpio_read(unsigned int g_bit) {
+	return !!(g_bit & ~gpio_read_all());
+}
+
+/**
+ * Read and negate status of all GPIOs, with one array call. GPIOs not used by the driver read as 1.
+ *
+ * @return Negated status of all GPIOs
+ */
+unsigned int gpio_read_all(void) {
+	unsigned long values = 0;
+	unsigned int i, levels = 0;
+
+	gpiod_get_raw_array_value(lines->ndescs, lines->desc, lines->info, &values);
+	for (i = 0; i < lines->ndescs; i++) {
+		if (values & BIT(i)) {
+			levels |= line_bit[i];
+		}
+	}
+	return ~levels;
+}
+
+/**
+ * Init function for the gpio part of the driver. Requests the GPIOs from the GPIO chip of the SoC.
+ *
+ * @param g_ids The GPIOs used by the driver
+ * @param n Number of GPIOs
+ * @return Result of the init operation
+ */
+int gpio_init(const unsigned int *g_ids, unsigned char n) {
+	const struct gpio_soc *soc;
+	struct gpio_descs *descs;
+	unsigned int i;
+	int status = 0;
+
+	soc = gpio_soc_detect();
+	if (!soc) {
+		return -ENODEV;
+	}
+	if (n > MAX_LINES) {
+		return -EINVAL;
+	}
+
+	pdev = platform_device_register_simple(KBUILD_MODNAME, -1, NULL, 0);
+	if (IS_ERR(pdev)) {
+		pr_err("Could not register the platform device\n");
+		return PTR_ERR(pdev);
+	}
+
+	// Map the GPIOs to the chip of the SoC, indexed in the order of the gpio parameter.
+	lookup = kzalloc(struct_size(lookup, table, n + 1), GFP_KERNEL);
+	if (!lookup) {
+		status = -ENOMEM;
+		goto err_device;
+	}
+	lookup->dev_id = dev_name(&pdev->dev);
+	for (i = 0; i < n; i++) {
+		lookup->table[i] = GPIO_LOOKUP_IDX(soc->label, g_ids[i], "bus", i, GPIO_ACTIVE_HIGH);
+	}
+	gpiod_add_lookup_table(lookup);
+
+	descs = gpiod_get_array(&pdev->dev, "bus", GPIOD_ASIS);
+	if (IS_ERR(descs)) {
+		pr_err("Could not request the GPIOs, they may be used by another driver\n");
+		status = PTR_ERR(descs);
+	} else {
+		// The bus is clocked from timers, the chip must not sleep.
+		lines = descs;
+		line_values = 0;
+		for (i = 0; i < lines->ndescs; i++) {
+			line_bit[i] = gpio_get_bit(g_ids[i]);
+			if (gpiod_cansleep(lines->desc[i])) {
+				pr_err("GPIO %u can sleep, it can not be used for the bus\n", g_ids[i]);
+				status = -EINVAL;
+			}
+		}
+	}
+
+	if (status != 0) {
+		gpio_exit();
+	}
+	return status;
+
+err_device:
+	platform_device_unregister(pdev);
+	pdev = NULL;
+	return status;
+}
+
+/**
+ * Exit function for the gpio part of the driver.
+ */
+void gpio_exit(void) {
+	if (lines) {
+		gpiod_put_array(lines);
+		lines = NULL;
+	}
+	if (lookup) {
+		gpiod_remove_lookup_table(lookup);
+		kfree(lookup);
+		lookup = NULL;
+	}
+	if (pdev) {
+		platform_device_unregister(pdev);
+		pdev = NULL;
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * GPIO registers of the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Register access shared by the backends that map the GPIO controller, gpio.c in the module and lib/gpiomem.c in
+ * the library. The functions take the mapped registers, udelay must be declared before this file is included.
+ */
+
+#ifndef SNESCON_GPIO_REGS_H_
+#define SNESCON_GPIO_REGS_H_
+
+#define GPIO_OFFSET 0x200000	// Offset of the GPIO registers from the peripheral base.
+#define GPIO_SIZE 0xF4
+
+#define GPSET 7	// Sets bits which are 1 and ignores bits which are 0.
+#define GPCLR 10	// Clears bits which are 1 and ignores bits which are 0.
+#define GPLEV 13	// Levels of the GPIOs.
+#define GPPUD 37	// Pull-up/down of the BCM2835, BCM2836 and BCM2837.
+#define GPPUDCLK 38
+#define GPIO_PUP_PDN_CNTRL 57	// Pull-up/down of the BCM2711, 2 bits per GPIO.
+
+// GPIO setup macros. Always use INP_GPIO(x) before using OUT_GPIO(x)
+#define INP_GPIO(gpio, g) *((gpio)+((g)/10)) &= ~(7<<(((g)%10)*3))	// Set GPIO as input.
+#define OUT_GPIO(gpio, g) *((gpio)+((g)/10)) |=  (1<<(((g)%10)*3))	// Set GPIO as output.
+
+/**
+ * Set GPIOs as input
+ *
+ * @param gpio The GPIO registers
+ * @param g_bit GPIOs
+ */
+static inline void gpio_regs_input(volatile unsigned *gpio, unsigned int g_bit) {
+	unsigned int g;
+
+	for (g = 0; g < 32; g++) {
+		if (g_bit & (1 << g)) {
+			INP_GPIO(gpio, g);
+		}
+	}
+}
+
+/**
+ * Set GPIOs as output.
+ *
+ * @param gpio The GPIO registers
+ * @param g_bit GPIOs
+ */
+static inline void gpio_regs_output(volatile unsigned *gpio, unsigned int g_bit) {
+	unsigned int g;
+
+	for (g = 0; g < 32; g++) {
+		if (g_bit & (1 << g)) {
+			INP_GPIO(gpio, g);
+			OUT_GPIO(gpio, g);
+		}
+	}
+}
+
+/**
+ * Activate internal pull-up.
+ *
+ * @param gpio The GPIO registers
+ * @param g_bit GPIOs
+ * @param pull_2711 The pull-ups are set like on the BCM2711
+ */
+static inline void gpio_regs_pull_up(volatile unsigned *gpio, unsigned int g_bit, bool pull_2711) {
+	unsigned int g, reg, shift;
+
+	if (pull_2711) {
+		for (g = 0; g < 32; g++) {
+			if (g_bit & (1 << g)) {
+				reg = GPIO_PUP_PDN_CNTRL + g / 16;
+				shift = (g % 16) * 2;
+				*(gpio + reg) = (*(gpio + reg) & ~(3 << shift)) | (1 << shift);
+			}
+		}
+		return;
+	}
+
+	*(gpio + GPPUD) = 2;
+	udelay(10);
+	*(gpio + GPPUDCLK) = g_bit;
+	udelay(10);
+	*(gpio + GPPUD) = 0;
+	*(gpio + GPPUDCLK) = 0;
+}
+
+#endif /* SNESCON_GPIO_REGS_H_ */
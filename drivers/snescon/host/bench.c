@@ -0,0 +1,570 @@
+/*
+ * Latency benchmark for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Runs pads_acquire and pads_update against the simulated bus for a scripted input session and reports the time
+ * spent on the bus, the time spent decoding and the number of input events. The bus time is simulated and exact,
+ * the decode time is measured on the host.
+ *
+ * The session is either random, with new buttons every -c polls, or read from a script with -s. Every line of a
+ * script holds <poll> <pad> <report> [<dx> <dy>], the report is the button bits in shift order, for example 0x1 for B.
+ * The state holds from that poll on, mouse motion is added on every poll.
+ *
+ * With -e lowcpu the bus is read with the low-CPU engine, which waits between the clock edges with a timer. The CPU
+ * time of a poll is then the time spent in the steps plus -w for every timer wakeup, rather than all of the bus time.
+ * The default -w is an assumption, not measured, and the CPU time reported for the engine follows it.
+ *
+ * With -b the captures of the session are recorded, then decoded again -b times in a row to time pads_update on
+ * its own, for every kind of controller. The devices are checked after every capture, so a change to the decoding
+ * can be checked for both speed and correctness.
+ */
+
+#define pr_fmt(fmt) "bench: " fmt
+
+#include <time.h>
+#include <unistd.h>
+#include "snescon_host.h"
+#include "gpio.h"
+#include "pads.h"
+#include "gpio_sim.h"
+
+#define SCRIPT_LINES 4096
+
+static const char *const devices[] = { "nes", "snes", "mouse", "fourscore", "multitap", "fourscore2", "multitap2" };
+
+// Buttons of the pads in the order of the driver, see pads.c
+static const long btn_label[] = { BTN_B, BTN_Y, BTN_SELECT, BTN_START, BTN_A, BTN_X, BTN_TL, BTN_TR };
+static const unsigned char btn_index[] = { 0, 1, 2, 3, 8, 9, 10, 11 };
+
+static const unsigned int gpio_id[] = { 2, 3, 4, 7, 10, 11, 17, 27 };	// Default GPIOs of the driver, and port2_d3 and port2_d4
+
+struct script_line {
+	unsigned long poll;
+	unsigned char pad;
+	u32 report;
+	int dx;
+	int dy;
+};
+
+/*
+ * A capture and the reports the controllers loaded for it.
+ */
+struct sample {
+	struct pads_capture cap;
+	u32 report[SIM_PADS];
+	int bits[SIM_PADS];
+};
+
+static struct script_line script[SCRIPT_LINES];
+static int script_len;
+
+static struct pads_config cfg;
+static bool lowcpu;	// Read the bus with the low-CPU engine
+static unsigned long wake_ns = 2000;	// CPU time of a timer wakeup of the low-CPU engine
+
+/**
+ * Read a script.
+ *
+ * @param path Path of the script
+ * @return Status
+ */
+static int script_load(const char *path) {
+	FILE *f = fopen(path, "r");
+	char line[256];
+	struct script_line *s;
+	unsigned int pad;
+	int n;
+
+	if (!f) {
+		pr_err("Could not open %s.\n", path);
+		return -ENOENT;
+	}
+
+	while (fgets(line, sizeof(line), f) && script_len < SCRIPT_LINES) {
+		s = &script[script_len];
+		s->dx = 0;
+		s->dy = 0;
+		n = sscanf(line, "%lu %u %i %d %d", &s->poll, &pad, &s->report, &s->dx, &s->dy);
+		if (n < 3 || line[0] == '#') {
+			continue;
+		}
+		if (pad >= SIM_PADS) {
+			pr_err("Invalid pad %u in %s.\n", pad, path);
+			fclose(f);
+			return -EINVAL;
+		}
+		s->pad = pad;
+		script_len++;
+	}
+	fclose(f);
+	return 0;
+}
+
+/**
+ * Set the controllers for a poll.
+ *
+ * @param poll Number of the poll
+ * @param change Polls between random changes
+ * @param motion Mouse motion of the random session
+ */
+static void session_step(unsigned long poll, unsigned long change, int *motion) {
+	int i;
+
+	if (script_len) {
+		for (i = 0; i < SIM_PADS; i++) {
+			motion[2 * i] = 0;
+			motion[2 * i + 1] = 0;
+		}
+		for (i = 0; i < script_len; i++) {
+			if (script[i].poll <= poll) {
+				sim.pad[script[i].pad].report = script[i].report;
+				motion[2 * script[i].pad] = script[i].dx;
+				motion[2 * script[i].pad + 1] = script[i].dy;
+			}
+		}
+	} else if (poll % change == 0) {
+		for (i = 0; i < SIM_PADS; i++) {
+			sim.pad[i].report = rand();
+			motion[2 * i] = rand() % 41 - 20;
+			motion[2 * i + 1] = rand() % 41 - 20;
+		}
+	}
+
+	for (i = 0; i < SIM_PADS; i++) {
+		sim.pad[i].dx += motion[2 * i];
+		sim.pad[i].dy += motion[2 * i + 1];
+	}
+}
+
+/**
+ * Read bit i of a report, bits past the end read as 1 like on the bus.
+ */
+static int wire(u32 report, int bits, int i) {
+	return (i < bits) ? (report >> i) & 1 : 1;
+}
+
+/**
+ * Decode one axis of a mouse report, a direction bit followed by a 7 bit magnitude, most significant bit first.
+ */
+static int axis(u32 report, int dir) {
+	int i, mag = 0;
+
+	for (i = dir + 1; i < dir + 8; i++) {
+		mag = (mag << 1) | ((report >> i) & 1);
+	}
+	return ((report >> dir) & 1) ? -mag : mag;
+}
+
+static s64 wall_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (s64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Check that the devices show what the controllers shifted out, and that the devices without a controller are clear.
+ *
+ * @param s The capture that was decoded and the loaded reports
+ * @param motion Summed motion of the mice, updated. May be NULL.
+ * @return Number of devices that differ
+ */
+static int session_check(const struct sample *s, long *motion) {
+	struct input_dev *dev;
+	u32 report;
+	int i, j, bits, n_keys, players, errors = 0;
+	bool bad, multitap;
+
+	if (sim.port[0] == SIM_FOURSCORE) {
+		players = (sim.port[2] == SIM_FOURSCORE) ? 8 : 4;
+	} else if (sim.port[1] == SIM_MULTITAP) {
+		players = (sim.port[0] == SIM_MULTITAP) ? 8 : 5;
+	} else {
+		players = 2;
+	}
+
+	// The transaction and the number of players must match the adapters that are connected.
+	multitap = s->cap.type == PADS_CAPTURE_MULTITAP || s->cap.type == PADS_CAPTURE_MULTITAP_DUAL;
+	if (multitap != (sim.port[1] == SIM_MULTITAP) ||
+	    (s->cap.type == PADS_CAPTURE_MULTITAP_DUAL) != (players == 8 && multitap) ||
+	    cfg.player_mode != players) {
+		errors++;
+	}
+
+	for (i = 0; i < SIM_PADS; i++) {
+		report = s->report[i];
+		bits = s->bits[i];
+
+		// Pad 6 - 8 only exist when a second adapter can be connected.
+		if (bits != BITS_LENGTH_MOUSE && !cfg.pad[i]) {
+			errors += bits != 0;
+			continue;
+		}
+
+		if (bits == BITS_LENGTH_MOUSE) {
+			dev = cfg.mouse[i];
+			bad = test_bit(BTN_RIGHT, dev->key) != wire(report, bits, 8) ||
+			      test_bit(BTN_LEFT, dev->key) != wire(report, bits, 9);
+			if (motion && s->cap.type == PADS_CAPTURE_MOUSE) {
+				motion[0] += axis(report, 24);
+				motion[1] += axis(report, 16);
+			}
+		} else if (bits == 0) {
+			dev = cfg.pad[i];
+			bad = dev->abs[ABS_X] != 0 || dev->abs[ABS_Y] != 0;
+			for (j = 0; j < 8; j++) {
+				bad |= test_bit(btn_label[j], dev->key);
+			}
+		} else {
+			dev = cfg.pad[i];
+			n_keys = (sim.port[0] == SIM_FOURSCORE) ? 4 : 8;
+			bad = dev->abs[ABS_X] != !wire(report, bits, 6) - !wire(report, bits, 7) ||
+			      dev->abs[ABS_Y] != !wire(report, bits, 4) - !wire(report, bits, 5);
+			for (j = 0; j < n_keys; j++) {
+				bad |= test_bit(btn_label[j], dev->key) != wire(report, bits, btn_index[j]);
+			}
+		}
+		errors += bad;
+	}
+	return errors;
+}
+
+/**
+ * Read the bus with the engine of the bench. The low-CPU engine sleeps until a step is due, the timer wakeup costs
+ * wake_ns and delays the step by as much.
+ *
+ * @param cap Capture to store the read data in
+ * @param cpu Set to the simulated CPU time of the read
+ * @param wakeups Incremented by the number of timer wakeups
+ * @return The simulated time spent on the bus
+ */
+static s64 bus_acquire(struct pads_capture *cap, s64 *cpu, unsigned long *wakeups) {
+	struct pads_bus bus;
+	s64 start = host_now(), step;
+	unsigned int us;
+
+	if (!lowcpu) {
+		pads_acquire(&cfg, cap);
+		*cpu = host_now() - start;
+		return *cpu;
+	}
+
+	*cpu = 0;
+	pads_bus_start(&cfg, &bus, cap);
+	do {
+		step = host_now();
+		us = pads_bus_step(&cfg, &bus);
+		*cpu += host_now() - step;
+		if (us) {
+			host_delay(us * 1000 + wake_ns);
+			*cpu += wake_ns;
+			(*wakeups)++;
+		}
+	} while (us);
+	return host_now() - start;
+}
+
+/**
+ * Acquire and decode one poll of the session.
+ *
+ * @param s Set to the capture and the loaded reports
+ * @param bus Set to the simulated time spent on the bus
+ * @param cpu Set to the simulated CPU time of the bus read
+ * @param wakeups Incremented by the number of timer wakeups of the bus read
+ * @param decode Set to the host time spent decoding
+ */
+static void session_poll(struct sample *s, s64 *bus, s64 *cpu, unsigned long *wakeups, s64 *decode) {
+	int i;
+
+	*bus = bus_acquire(&s->cap, cpu, wakeups);
+
+	*decode = wall_ns();
+	pads_update(&cfg, &s->cap);
+	*decode = wall_ns() - *decode;
+
+	for (i = 0; i < SIM_PADS; i++) {
+		sim_expected(i, &s->report[i], &s->bits[i]);
+	}
+}
+
+static unsigned long events(void) {
+	unsigned long n = 0;
+	int i;
+
+	for (i = 0; i < NUMBER_OF_INPUT_DEVICES; i++) {
+		n += cfg.pad[i] ? cfg.pad[i]->events : 0;
+	}
+	for (i = 0; i < NUMBER_OF_MICE; i++) {
+		n += cfg.mouse[i] ? cfg.mouse[i]->events : 0;
+	}
+	return n;
+}
+
+/**
+ * Connect the controllers and set up the driver for them.
+ *
+ * @param type Name of the controllers
+ * @param detect_all Detect Multitap and Four Score whatever is connected
+ * @return Status
+ */
+static int bench_setup(const char *type, bool detect_all) {
+	int i;
+
+	memset(&cfg, 0, sizeof(cfg));
+	memset(sim.pad, 0, sizeof(sim.pad));
+	memset(sim.port, 0, sizeof(sim.port));
+	cfg.device_name = "SNES pad";
+	cfg.n_gpios = NUMBER_OF_GPIOS;
+	cfg.mouse_speed = 1;
+
+	if (!strcmp(type, "nes")) {
+		sim.port[0] = sim.port[1] = SIM_NES;
+	} else if (!strcmp(type, "snes")) {
+		sim.port[0] = sim.port[1] = SIM_SNES;
+	} else if (!strcmp(type, "mouse")) {
+		sim.port[0] = sim.port[1] = SIM_MOUSE;
+		cfg.mouse_enabled = true;
+	} else if (!strcmp(type, "fourscore")) {
+		sim.port[0] = sim.port[1] = SIM_FOURSCORE;
+		cfg.fourscore_enabled = true;
+	} else if (!strcmp(type, "multitap")) {
+		sim.port[0] = SIM_SNES;
+		sim.port[1] = SIM_MULTITAP;
+		cfg.multitap_enabled = true;
+	} else if (!strcmp(type, "fourscore2")) {
+		sim.port[0] = sim.port[1] = sim.port[2] = sim.port[3] = SIM_FOURSCORE;
+		cfg.fourscore_enabled = true;
+		cfg.n_gpios = MAX_NUMBER_OF_GPIOS;
+	} else if (!strcmp(type, "multitap2")) {
+		sim.port[0] = sim.port[1] = SIM_MULTITAP;
+		cfg.multitap_enabled = true;
+		cfg.n_gpios = MAX_NUMBER_OF_GPIOS;
+	} else {
+		pr_err("Unknown device %s.\n", type);
+		return -EINVAL;
+	}
+	// With a second adapter port2_d3 and port2_d4 are used by either the Multitap or the Four Score.
+	if (detect_all && cfg.n_gpios == NUMBER_OF_GPIOS) {
+		cfg.multitap_enabled = true;
+		cfg.fourscore_enabled = true;
+	}
+
+	for (i = 0; i < MAX_NUMBER_OF_GPIOS; i++) {
+		cfg.gpio[i] = (i < cfg.n_gpios) ? 1 << gpio_id[i] : 0;
+		sim.gpio[i] = 1 << gpio_id[i];
+	}
+	srand(sim.seed);
+	sim_reset();
+
+	if (pads_setup(&cfg) != 0) {
+		return -ENOMEM;
+	}
+	return pads_register(&cfg);
+}
+
+/**
+ * Run a session and report the bus time, decode time and events.
+ *
+ * @param type Name of the controllers
+ * @param polls Number of polls
+ * @param change Polls between random changes
+ * @return Number of polls where the devices differ from the controllers
+ */
+static unsigned long bench_session(const char *type, unsigned long polls, unsigned long change) {
+	struct sample s;
+	unsigned long poll, accesses = 0, wakeups = 0, errors = 0, bad_polls = 0, ev;
+	s64 bus, cpu, decode, bus_total = 0, bus_max = 0, cpu_total = 0, cpu_max = 0, decode_total = 0, decode_max = 0;
+	long motion[2] = { 0, 0 }, reported[2] = { 0, 0 };
+	int step[2 * SIM_PADS] = { 0 };
+	int i, n;
+
+	for (poll = 0; poll < polls; poll++) {
+		session_step(poll, change, step);
+		accesses = sim_accesses();
+		session_poll(&s, &bus, &cpu, &wakeups, &decode);
+
+		bus_total += bus;
+		bus_max = bus > bus_max ? bus : bus_max;
+		cpu_total += cpu;
+		cpu_max = cpu > cpu_max ? cpu : cpu_max;
+		decode_total += decode;
+		decode_max = decode > decode_max ? decode : decode_max;
+
+		n = session_check(&s, motion);
+		errors += n;
+		bad_polls += n != 0;
+	}
+
+	ev = events();
+	for (i = 0; i < NUMBER_OF_MICE; i++) {
+		if (cfg.mouse[i]) {
+			reported[0] += cfg.mouse[i]->rel[REL_X];
+			reported[1] += cfg.mouse[i]->rel[REL_Y];
+		}
+	}
+
+	printf("device:  %s, %lu polls\n", type, polls);
+	printf("bus:     avg %lld ns, max %lld ns, %lu GPIO accesses per poll (simulated)\n",
+	       (long long)(bus_total / polls), (long long)bus_max, sim_accesses() - accesses);
+	printf("cpu:     avg %lld ns, max %lld ns, %.1f timer wakeups per poll, %s engine (simulated)\n",
+	       (long long)(cpu_total / polls), (long long)cpu_max, (double)wakeups / polls, lowcpu ? "lowcpu" : "delay");
+	printf("decode:  avg %lld ns, max %lld ns (host)\n", (long long)(decode_total / polls), (long long)decode_max);
+	printf("events:  %lu, %.2f per poll\n", ev, (double)ev / polls);
+	printf("errors:  %lu in %lu polls, the adapter or devices differ from the controllers\n", errors, bad_polls);
+	if (cfg.mouse_enabled) {
+		printf("motion:  x %ld y %ld read, x %ld y %ld reported\n", motion[0], motion[1], reported[0], reported[1]);
+	}
+	return bad_polls;
+}
+
+/**
+ * Record the captures of a session and time decoding them again.
+ *
+ * @param type Name of the controllers
+ * @param polls Number of polls
+ * @param change Polls between random changes
+ * @param rounds Number of times all captures are decoded
+ * @return Number of captures where the devices differ from the controllers
+ */
+static unsigned long bench_decode(const char *type, unsigned long polls, unsigned long change, unsigned long rounds) {
+	struct sample *samples = calloc(polls, sizeof(*samples));
+	unsigned long poll, round, bad_polls = 0;
+	int step[2 * SIM_PADS] = { 0 };
+	unsigned long wakeups = 0;
+	s64 bus, cpu, decode, total;
+
+	if (!samples) {
+		pr_err("Not enough memory for %lu captures.\n", polls);
+		return polls;
+	}
+
+	for (poll = 0; poll < polls; poll++) {
+		session_step(poll, change, step);
+		session_poll(&samples[poll], &bus, &cpu, &wakeups, &decode);
+	}
+
+	total = wall_ns();
+	for (round = 0; round < rounds; round++) {
+		for (poll = 0; poll < polls; poll++) {
+			pads_update(&cfg, &samples[poll].cap);
+		}
+	}
+	total = wall_ns() - total;
+
+	for (poll = 0; poll < polls; poll++) {
+		pads_update(&cfg, &samples[poll].cap);
+		bad_polls += session_check(&samples[poll], NULL) != 0;
+	}
+
+	printf("%-10s %8.1f ns per capture, %lu captures x %lu, %lu wrong\n",
+	       type, (double)total / ((double)polls * rounds), polls, rounds, bad_polls);
+	free(samples);
+	return bad_polls;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -t <device>  nes, snes, mouse, fourscore, multitap, or fourscore2 and multitap2 for two adapters (snes)\n"
+		"  -p <polls>   Number of polls (10000)\n"
+		"  -c <polls>   Polls between changes of a random session (5)\n"
+		"  -s <script>  Read the session from a script\n"
+		"  -a           Detect Multitap and Four Score whatever is connected, with one adapter\n"
+		"  -b <rounds>  Time decoding of the recorded captures, for all devices unless -t is given\n"
+		"  -e <engine>  Bus engine, delay or lowcpu (delay)\n"
+		"  -w <ns>      CPU time of a timer wakeup of the lowcpu engine, assumed (2000)\n"
+		"  -o <ns>      Time of a GPIO register access (60)\n"
+		"  -d <ns>      Time until a bit is valid after the rising clock edge (0)\n"
+		"  -n <ppm>     Probability of a data line being read wrong (0)\n"
+		"  -r <seed>    Seed of the session and the noise (1)\n",
+		name);
+}
+
+int main(int argc, char **argv) {
+	unsigned long polls = 10000, change = 5, rounds = 0, bad_polls = 0;
+	const char *type = NULL;
+	bool detect_all = false;
+	int i, opt;
+
+	sim.op_ns = 60;
+	sim.seed = 1;
+
+	while ((opt = getopt(argc, argv, "t:p:c:s:ab:e:w:o:d:n:r:h")) != -1) {
+		switch (opt) {
+		case 't':
+			type = optarg;
+			break;
+		case 'p':
+			polls = strtoul(optarg, NULL, 0);
+			polls = polls ? polls : 1;
+			break;
+		case 'c':
+			change = strtoul(optarg, NULL, 0);
+			change = change ? change : 1;
+			break;
+		case 's':
+			if (script_load(optarg) != 0) {
+				return 1;
+			}
+			break;
+		case 'a':
+			detect_all = true;
+			break;
+		case 'b':
+			rounds = strtoul(optarg, NULL, 0);
+			rounds = rounds ? rounds : 1;
+			break;
+		case 'e':
+			if (strcmp(optarg, "delay") && strcmp(optarg, "lowcpu")) {
+				pr_err("Unknown engine %s.\n", optarg);
+				return 1;
+			}
+			lowcpu = !strcmp(optarg, "lowcpu");
+			break;
+		case 'w':
+			wake_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			sim.op_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			sim.valid_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			sim.noise_ppm = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			sim.seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!rounds) {
+		type = type ? type : "snes";
+		if (bench_setup(type, detect_all) != 0) {
+			return 1;
+		}
+		bad_polls = bench_session(type, polls, change);
+		pads_remove(&cfg);
+		return bad_polls != 0;
+	}
+
+	for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+		if (type && strcmp(type, devices[i])) {
+			continue;
+		}
+		if (bench_setup(devices[i], detect_all) != 0) {
+			return 1;
+		}
+		bad_polls += bench_decode(devices[i], polls, change, rounds);
+		pads_remove(&cfg);
+	}
+	return bad_polls != 0;
+}
@@ -0,0 +1,400 @@
+/*
+ * Simulated bus for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Replaces gpio.c in the host build. The GPIO register is kept in memory and the controllers react to the edges
+ * of clk, latch and the pp lines the way the shift registers in the real controllers do. Time only passes through
+ * udelay and the GPIO accesses, so a session runs as fast as the host allows and always gives the same result.
+ */
+
+#include "snescon_host.h"
+#include "gpio.h"
+#include "gpio_sim.h"
+
+#define CHAINS SIM_PADS	// Shift registers that can be on the bus, one per pad
+
+struct sim_bus sim;
+
+/*
+ * A shift register. Bit pos of report is on the data line, bits past the end of the report read as 1.
+ */
+struct sim_chain {
+	u32 report;
+	int bits;
+	int pos;
+	s64 shifted;	// Time of the last shift
+	int prev;	// The bit that was on the data line before the last shift
+	unsigned int line;	// The data line
+	unsigned int pp;	// The pp line of the Multitap the register is in, 0 if it is always selected
+	int pp_level;	// Level of pp that selects the register
+	unsigned int tap_d0;	// D0 of the Multitap, the Multitap echoes it on D1 while the host drives it
+};
+
+const bool gpio_atomic_direction = true;
+
+static s64 now;
+static unsigned long accesses;
+static unsigned int out_mask;
+static unsigned int out_level;
+static unsigned int pull_mask;
+static u32 rng;
+static struct sim_chain chain[CHAINS];
+static int n_chains;
+static u32 loaded[SIM_PADS];
+static int loaded_bits[SIM_PADS];
+
+s64 host_now(void) {
+	return now;
+}
+
+void host_delay(unsigned long ns) {
+	now += ns;
+}
+
+/**
+ * Number of GPIO register accesses since the last reset.
+ *
+ * @return The number of accesses
+ */
+unsigned long sim_accesses(void) {
+	return accesses;
+}
+
+/**
+ * Account for one access to the GPIO registers.
+ */
+static void sim_access(void) {
+	now += sim.op_ns;
+	accesses++;
+}
+
+/**
+ * Draw a random number, xorshift32.
+ *
+ * @return The number
+ */
+static u32 sim_random(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+/**
+ * Number of bits in the report of a controller.
+ *
+ * @param type The controller
+ * @return Number of bits
+ */
+static int sim_bits(unsigned int type) {
+	switch (type) {
+	case SIM_NES:
+	case SIM_FOURSCORE:
+		return 8;
+	case SIM_MOUSE:
+		return 32;
+	default:
+		return 16;
+	}
+}
+
+/**
+ * Build the report of a SNES Mouse. The motion counters are cleared by the latch and saturate at 127.
+ *
+ * @param pad The mouse
+ * @return The report
+ */
+static u32 sim_mouse_report(struct sim_pad *pad) {
+	u32 report = (pad->report & 0x300) | (1 << 15);
+	int mag, k;
+
+	report |= ((pad->speed >> 1) & 1) << 10;
+	report |= (pad->speed & 1) << 11;
+
+	mag = pad->dy < 0 ? -pad->dy : pad->dy;
+	mag = mag > 127 ? 127 : mag;
+	report |= (pad->dy < 0) << 16;
+	for (k = 0; k < 7; k++) {
+		report |= ((mag >> (6 - k)) & 1) << (17 + k);
+	}
+
+	mag = pad->dx < 0 ? -pad->dx : pad->dx;
+	mag = mag > 127 ? 127 : mag;
+	report |= (u32)(pad->dx < 0) << 24;
+	for (k = 0; k < 7; k++) {
+		report |= (u32)((mag >> (6 - k)) & 1) << (25 + k);
+	}
+
+	pad->dx = 0;
+	pad->dy = 0;
+	return report;
+}
+
+/**
+ * Load the report of a controller into a new shift register.
+ *
+ * @param pad The controller
+ * @param type Type of the controller
+ * @param line The data line
+ * @param pp The pp line of the Multitap, 0 if the controller is not in a Multitap
+ * @param pp_level Level of pp that selects the controller
+ */
+static void sim_connect(int pad, unsigned int type, unsigned int line, unsigned int pp, int pp_level) {
+	struct sim_chain *c = &chain[n_chains++];
+
+	loaded[pad] = (type == SIM_MOUSE) ? sim_mouse_report(&sim.pad[pad]) : sim.pad[pad].report & ((1 << sim_bits(type)) - 1);
+	loaded_bits[pad] = sim_bits(type);
+	c->report = loaded[pad];
+	c->bits = loaded_bits[pad];
+	c->line = line;
+	c->pp = pp;
+	c->pp_level = pp_level;
+}
+
+/**
+ * Connect a Multitap. Its first two pads are selected while pp is high, the other two while it is low.
+ *
+ * @param pads The pads of the Multitap, in the order of the driver
+ * @param d0 D0 of the port
+ * @param d1 D1 of the port
+ * @param pp PP of the port
+ */
+static void sim_multitap(const int *pads, unsigned int d0, unsigned int d1, unsigned int pp) {
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		sim_connect(pads[i], SIM_SNES, (i & 1) ? d1 : d0, pp, i < 2);
+		chain[n_chains - 1].tap_d0 = d0;
+	}
+}
+
+/**
+ * Parallel load of all shift registers, the controllers hold the state they had when latch is released.
+ */
+static void sim_load(void) {
+	static const int tap_port1[] = { 0, 5, 6, 7 }, tap_port2[] = { 1, 2, 3, 4 };
+	unsigned int line;
+	int i, f, port;
+
+	memset(chain, 0, sizeof(chain));
+	n_chains = 0;
+	for (i = 0; i < SIM_PADS; i++) {
+		loaded[i] = 0;
+		loaded_bits[i] = 0;
+	}
+
+	// The Four Score shifts out both of its pads on a port, followed by an 8 bit signature.
+	for (f = 0; f < 2; f++) {
+		if (sim.port[2 * f] != SIM_FOURSCORE || (f == 1 && sim.port[0] != SIM_FOURSCORE)) {
+			continue;
+		}
+		for (port = 0; port < 2; port++) {
+			i = 4 * f + port;
+			line = f ? sim.gpio[6 + port] : sim.gpio[2 + port];
+			loaded[i] = sim.pad[i].report & 0xFF;
+			loaded[i + 2] = sim.pad[i + 2].report & 0xFF;
+			loaded_bits[i] = 8;
+			loaded_bits[i + 2] = 8;
+			chain[n_chains].report = loaded[i] | (loaded[i + 2] << 8) | (1 << (19 - port));
+			chain[n_chains].bits = 24;
+			chain[n_chains].line = line;
+			n_chains++;
+		}
+	}
+	if (sim.port[0] == SIM_FOURSCORE) {
+		return;
+	}
+
+	if (sim.port[0] == SIM_MULTITAP) {
+		sim_multitap(tap_port1, sim.gpio[2], sim.gpio[6], sim.gpio[7]);
+	} else if (sim.port[0] != SIM_NONE) {
+		sim_connect(0, sim.port[0], sim.gpio[2], 0, 0);
+	}
+
+	if (sim.port[1] == SIM_MULTITAP) {
+		sim_multitap(tap_port2, sim.gpio[3], sim.gpio[4], sim.gpio[5]);
+	} else if (sim.port[1] != SIM_NONE) {
+		sim_connect(1, sim.port[1], sim.gpio[3], 0, 0);
+	}
+}
+
+/**
+ * Read the data line of a shift register.
+ *
+ * @param c The shift register
+ * @return 1 if the data line is pulled low
+ */
+static int sim_chain_bit(struct sim_chain *c) {
+	int bit = (c->pos < c->bits) ? (c->report >> c->pos) & 1 : 1;
+
+	if (c->pos > 0 && now - c->shifted < sim.valid_ns) {
+		bit = c->prev;
+	}
+	if (sim.noise_ppm && sim_random() % 1000000 < sim.noise_ppm) {
+		bit = !bit;
+	}
+	return bit;
+}
+
+/**
+ * Shift a register on the rising clock edge.
+ *
+ * @param c The shift register
+ */
+static void sim_chain_shift(struct sim_chain *c) {
+	c->prev = (c->pos < c->bits) ? (c->report >> c->pos) & 1 : 1;
+	c->pos++;
+	c->shifted = now;
+}
+
+/**
+ * Check if a shift register is selected by the pp line of its Multitap.
+ *
+ * @param c The shift register
+ * @return 1 if the register is selected
+ */
+static int sim_selected(const struct sim_chain *c) {
+	return !c->pp || !!(out_level & c->pp) == c->pp_level;
+}
+
+/**
+ * React to the edges of the outputs.
+ *
+ * @param old Output levels before the access
+ */
+static void sim_edges(unsigned int old) {
+	unsigned int clk = sim.gpio[0], latch = sim.gpio[1];
+	unsigned int rise = ~old & out_level & out_mask;
+	unsigned int fall = old & ~out_level & out_mask;
+	int i;
+
+	if (fall & latch) {
+		sim_load();
+	}
+
+	if (!(rise & clk)) {
+		return;
+	}
+
+	if (out_level & latch) {
+		// A clock pulse while latched cycles the sensitivity of the mice.
+		for (i = 0; i < SIM_PORTS; i++) {
+			if (sim.port[i] == SIM_MOUSE) {
+				sim.pad[i].speed = (sim.pad[i].speed + 1) % 3;
+			}
+		}
+		return;
+	}
+
+	// Only the selected pair of pads of a Multitap is clocked.
+	for (i = 0; i < n_chains; i++) {
+		if (sim_selected(&chain[i])) {
+			sim_chain_shift(&chain[i]);
+		}
+	}
+}
+
+/**
+ * Levels of all lines on the bus.
+ *
+ * @return Levels, 1 for high
+ */
+static unsigned int sim_levels(void) {
+	unsigned int level = pull_mask & ~out_mask;
+	struct sim_chain *c;
+	int i;
+
+	level |= out_level & out_mask;
+
+	for (i = 0; i < n_chains; i++) {
+		c = &chain[i];
+		if (c->tap_d0 & out_mask) {
+			// The Multitap echoes D0 on D1 when the host drives D0.
+			if (c->line != c->tap_d0) {
+				level = (level & ~c->line) | ((out_level & c->tap_d0) ? c->line : 0);
+			}
+			continue;
+		}
+		if (c->bits && sim_selected(c) && !(c->line & out_mask) && sim_chain_bit(c)) {
+			level &= ~c->line;
+		}
+	}
+	return level;
+}
+
+/**
+ * Reset the bus to power on state and connect the controllers in sim.
+ */
+void sim_reset(void) {
+	now = 0;
+	accesses = 0;
+	out_mask = 0;
+	out_level = 0;
+	pull_mask = 0;
+	rng = sim.seed ? sim.seed : 1;
+	sim_load();
+}
+
+/**
+ * Get the report a controller loaded at the last latch, before timing and noise.
+ *
+ * @param pad The controller
+ * @param report Set to the report
+ * @param bits Set to the number of bits in the report, 0 when the controller is not connected
+ */
+void sim_expected(unsigned char pad, u32 *report, int *bits) {
+	*report = loaded[pad];
+	*bits = loaded_bits[pad];
+}
+
+void gpio_set(unsigned int g_bit) {
+	unsigned int old = out_level;
+
+	sim_access();
+	out_level |= g_bit;
+	sim_edges(old);
+}
+
+void gpio_clear(unsigned int g_bit) {
+	unsigned int old = out_level;
+
+	sim_access();
+	out_level &= ~g_bit;
+	sim_edges(old);
+}
+
+void gpio_input(unsigned int g_bit) {
+	sim_access();
+	out_mask &= ~g_bit;
+}
+
+void gpio_output(unsigned int g_bit) {
+	sim_access();
+	out_mask |= g_bit;
+}
+
+void gpio_enable_pull_up(unsigned int g_bit) {
+	sim_access();
+	pull_mask |= g_bit;
+}
+
+unsigned char gpio_read(unsigned int g_bit) {
+	sim_access();
+	return !!(g_bit & sim_levels());
+}
+
+unsigned int gpio_read_all(void) {
+	sim_access();
+	return ~sim_levels();
+}
+
+int gpio_init(const unsigned int *g_ids, unsigned char n) {
+	return 0;
+}
+
+void gpio_exit(void) {
+}
@@ -0,0 +1,62 @@
+/*
+ * Simulated bus for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+#ifndef SNESCON_GPIO_SIM_H_
+#define SNESCON_GPIO_SIM_H_
+
+#include "snescon_host.h"
+
+// Devices that can be connected to the simulated ports
+#define SIM_NONE 0
+#define SIM_NES 1
+#define SIM_SNES 2
+#define SIM_MOUSE 3
+#define SIM_FOURSCORE 4	// Connects to port 1 and 2, or to port 3 and 4
+#define SIM_MULTITAP 5	// Connects to port 2, or to port 1
+
+#define SIM_PORTS 4	// Port 3 and 4 only take the second Four Score
+#define SIM_PADS 8
+
+/*
+ * Controller behind a port.
+ *
+ * report holds the buttons as shifted out, bit 0 first. A set bit pulls the data line low, which the driver reads as 1.
+ */
+struct sim_pad {
+	u32 report;
+	int dx;	// Mouse motion since the last latch, positive for right and down
+	int dy;
+	unsigned int speed;	// Mouse sensitivity, cycled by a clock pulse while latched
+};
+
+/*
+ * Configuration of the simulated bus.
+ *
+ * gpio: <clk, latch, port1_d0, port2_d0, port2_d1, port2_pp, port2_d3, port2_d4> as bits in the GPIO register, like
+ * in struct pads_config. port2_d3 and port2_d4 are port1_d1 and port1_pp of a Multitap on port 1, or port3_d0 and
+ * port4_d0 of a Four Score on port 3 and 4.
+ * pad: the controllers, numbered like the input devices of the driver. With a Four Score pad 0 and 2 are on port 1,
+ * pad 1 and 3 on port 2, and with a second one pad 4 and 6 on port 3, pad 5 and 7 on port 4. With a Multitap pad 0
+ * is on port 1 and pad 1 - 4 on the Multitap. A second Multitap on port 1 has pad 0 and 5 - 7.
+ */
+struct sim_bus {
+	unsigned int gpio[8];
+	unsigned int port[SIM_PORTS];
+	struct sim_pad pad[SIM_PADS];
+	unsigned int op_ns;	// Time of one access to the GPIO registers
+	unsigned int valid_ns;	// Time from the rising clock edge until the next bit is valid on the data lines
+	unsigned int noise_ppm;	// Probability that a data line is read wrong, in parts per million
+	unsigned int seed;
+};
+
+extern struct sim_bus sim;
+
+void sim_reset(void);
+void sim_expected(unsigned char pad, u32 *report, int *bits);
+unsigned long sim_accesses(void);
+
+#endif /* SNESCON_GPIO_SIM_H_ */
@@ -0,0 +1,69 @@
+/*
+ * Host build of the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * The part of KUnit used by pads_kunit.c, so the suite can be run on the host by kunit.c. Like in the kernel, a failed
+ * assertion ends the test case, the exit function still runs, and the memory of kunit_kzalloc is freed after it.
+ */
+
+#ifndef SNESCON_HOST_KUNIT_TEST_H_
+#define SNESCON_HOST_KUNIT_TEST_H_
+
+#include <setjmp.h>
+#include "../snescon_host.h"
+
+struct kunit_resource;
+
+struct kunit {
+	void *priv;
+	const char *name;
+	bool failed;
+	jmp_buf abort;	// Taken by a failed assertion
+	struct kunit_resource *resources;
+};
+
+struct kunit_case {
+	void (*run_case)(struct kunit *test);
+	const char *name;
+};
+
+struct kunit_suite {
+	const char name[256];
+	int (*init)(struct kunit *test);
+	void (*exit)(struct kunit *test);
+	struct kunit_case *test_cases;
+};
+
+#define KUNIT_CASE(test_name) { .run_case = test_name, .name = #test_name }
+
+// The host runs the one suite that is linked in
+#define kunit_test_suite(suite) struct kunit_suite *kunit_host_suite = &(suite)
+
+void *kunit_kzalloc(struct kunit *test, size_t size, int gfp);
+void kunit_fail(struct kunit *test, const char *file, int line, const char *fmt, ...)
+	__attribute__((format(printf, 4, 5)));
+
+#define kunit_info(test, fmt, ...) printf("    # %s: " fmt, (test)->name, ##__VA_ARGS__)
+
+#define KUNIT_EXPECT_EQ_MSG(test, left, right, fmt, ...) do { \
+	long long _left = (left), _right = (right); \
+	if (_left != _right) { \
+		kunit_fail(test, __FILE__, __LINE__, "Expected %s == %s, but %s == %lld, %s == %lld " fmt, \
+			   #left, #right, #left, _left, #right, _right, ##__VA_ARGS__); \
+	} \
+} while (0)
+#define KUNIT_EXPECT_EQ(test, left, right) KUNIT_EXPECT_EQ_MSG(test, left, right, "")
+#define KUNIT_EXPECT_TRUE(test, condition) KUNIT_EXPECT_EQ_MSG(test, !!(condition), 1, "")
+#define KUNIT_EXPECT_FALSE(test, condition) KUNIT_EXPECT_EQ_MSG(test, !!(condition), 0, "")
+#define KUNIT_ASSERT_NOT_NULL(test, ptr) do { \
+	if (!(ptr)) { \
+		kunit_fail(test, __FILE__, __LINE__, "Expected %s is not null", #ptr); \
+		longjmp((test)->abort, 1); \
+	} \
+} while (0)
+
+#endif /* SNESCON_HOST_KUNIT_TEST_H_ */
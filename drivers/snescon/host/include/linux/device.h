@@ -0,0 +1 @@
+#include "../snescon_host.h"
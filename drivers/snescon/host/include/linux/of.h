@@ -0,0 +1,4 @@
+#include "../snescon_host.h"
+
+// Reads /proc/device-tree in the library, see lib/gpiomem.c.
+bool of_machine_is_compatible(const char *compat);
@@ -0,0 +1,219 @@
+/*
+ * Host build of the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * The small part of the kernel API used by pads.c, implemented in userspace so the pads can be built and run outside
+ * of the kernel, against the simulated bus in host/ or /dev/gpiomem in lib/. All of the linux/ headers in this
+ * directory include this file, so system headers that include linux/ headers can not be used next to it.
+ */
+
+#ifndef SNESCON_HOST_H_
+#define SNESCON_HOST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <linux/input-event-codes.h>
+
+typedef int8_t s8;
+typedef uint8_t u8;
+typedef int16_t s16;
+typedef uint16_t u16;
+typedef int32_t s32;
+typedef uint32_t u32;
+typedef long long s64;
+typedef unsigned long long u64;
+typedef s64 ktime_t;
+
+#define __init
+#define __exit
+
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE KERNEL_VERSION(5, 4, 0)
+
+#define MODULE_AUTHOR(author)
+#define MODULE_DESCRIPTION(description)
+#define MODULE_LICENSE(license)
+
+#define pr_err(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warn(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_info(fmt, ...) fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__)
+
+#define min_t(type, x, y) ((type)(x) < (type)(y) ? (type)(x) : (type)(y))
+#define max_t(type, x, y) ((type)(x) > (type)(y) ? (type)(x) : (type)(y))
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+// Bitmaps
+#define BITS_PER_LONG (8 * sizeof(long))
+#define BITS_TO_LONGS(nr) (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define BIT_MASK(nr) (1UL << ((nr) % BITS_PER_LONG))
+#define BIT_WORD(nr) ((nr) / BITS_PER_LONG)
+
+static inline void __set_bit(int nr, unsigned long *addr) {
+	addr[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline int test_bit(int nr, const unsigned long *addr) {
+	return !!(addr[BIT_WORD(nr)] & BIT_MASK(nr));
+}
+
+// Memory
+#define GFP_KERNEL 0
+
+static inline void *kzalloc(size_t size, int flags) {
+	return calloc(1, size);
+}
+
+static inline void kfree(const void *p) {
+	free((void *)p);
+}
+
+// Time, provided by the GPIO backend. Simulated in gpio_sim.c, CLOCK_MONOTONIC in the library.
+s64 host_now(void);
+void host_delay(unsigned long ns);
+
+static inline ktime_t ktime_get(void) {
+	return host_now();
+}
+
+static inline u64 ktime_get_ns(void) {
+	return host_now();
+}
+
+static inline s64 ktime_to_ns(ktime_t kt) {
+	return kt;
+}
+
+static inline ktime_t ns_to_ktime(u64 ns) {
+	return ns;
+}
+
+static inline void udelay(unsigned long us) {
+	host_delay(us * 1000);
+}
+
+static inline void ndelay(unsigned long ns) {
+	host_delay(ns);
+}
+
+// Devices and sysfs attributes
+struct attribute {
+	const char *name;
+};
+
+struct attribute_group {
+	struct attribute **attrs;
+};
+
+struct device {
+	const struct attribute_group **groups;
+};
+
+struct device_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct device *dev, struct device_attribute *attr, char *buf);
+};
+
+#define DEVICE_ATTR_RO(_name) \
+	struct device_attribute dev_attr_##_name = { .attr = { .name = #_name }, .show = _name##_show }
+
+#define ATTRIBUTE_GROUPS(_name) \
+	static const struct attribute_group _name##_group = { .attrs = _name##_attrs }; \
+	static const struct attribute_group *_name##_groups[] = { &_name##_group, NULL }
+
+// Input devices
+#define BUS_PARPORT 0x04
+
+struct input_id {
+	u16 bustype;
+	u16 vendor;
+	u16 product;
+	u16 version;
+};
+
+struct input_dev {
+	const char *name;
+	const char *phys;
+	struct input_id id;
+	unsigned long propbit[BITS_TO_LONGS(INPUT_PROP_CNT)];
+	unsigned long evbit[BITS_TO_LONGS(EV_CNT)];
+	unsigned long keybit[BITS_TO_LONGS(KEY_CNT)];
+	unsigned long relbit[BITS_TO_LONGS(REL_CNT)];
+	unsigned long absbit[BITS_TO_LONGS(ABS_CNT)];
+	int (*open)(struct input_dev *dev);
+	void (*close)(struct input_dev *dev);
+	struct device dev;
+
+	// Host input core state
+	void *drvdata;
+	unsigned long key[BITS_TO_LONGS(KEY_CNT)];
+	int abs[ABS_CNT];
+	int abs_min[ABS_CNT];
+	int abs_max[ABS_CNT];
+	int rel[REL_CNT];	// Motion summed over all reports
+	ktime_t timestamp;
+	unsigned int pending;	// Events since the last sync
+	unsigned long events;	// Events passed on, empty syncs excluded
+	unsigned long frames;	// Syncs that carried events
+	bool registered;
+	void *host;	// Owner data of the program the pads are built into
+};
+
+#define to_input_dev(d) container_of(d, struct input_dev, dev)
+
+struct input_dev *input_allocate_device(void);
+void input_free_device(struct input_dev *dev);
+int input_register_device(struct input_dev *dev);
+void input_unregister_device(struct input_dev *dev);
+void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
+void input_set_abs_params(struct input_dev *dev, unsigned int axis, int min, int max, int fuzz, int flat);
+void input_event(struct input_dev *dev, unsigned int type, unsigned int code, int value);
+void input_set_timestamp(struct input_dev *dev, ktime_t timestamp);
+
+static inline void input_set_drvdata(struct input_dev *dev, void *data) {
+	dev->drvdata = data;
+}
+
+static inline void *input_get_drvdata(struct input_dev *dev) {
+	return dev->drvdata;
+}
+
+static inline int input_abs_get_val(struct input_dev *dev, unsigned int axis) {
+	return dev->abs[axis];
+}
+
+static inline void input_report_key(struct input_dev *dev, unsigned int code, int value) {
+	input_event(dev, EV_KEY, code, !!value);
+}
+
+static inline void input_report_rel(struct input_dev *dev, unsigned int code, int value) {
+	input_event(dev, EV_REL, code, value);
+}
+
+static inline void input_report_abs(struct input_dev *dev, unsigned int code, int value) {
+	input_event(dev, EV_ABS, code, value);
+}
+
+static inline void input_sync(struct input_dev *dev) {
+	input_event(dev, EV_SYN, SYN_REPORT, 0);
+}
+
+/*
+ * Called for every event passed on by the host input core, including the SYN_REPORT closing a frame.
+ * NULL by default.
+ */
+extern void (*host_input_handler)(struct input_dev *dev, unsigned int type, unsigned int code, int value);
+
+#endif /* SNESCON_HOST_H_ */
@@ -0,0 +1,112 @@
+/*
+ * Host input core for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Keeps the state of the input devices the way the kernel input core does. Keys and absolute axes that do not
+ * change, relative motion of 0 and empty frames are filtered, so the counters show what userspace would receive.
+ */
+
+#include "snescon_host.h"
+
+void (*host_input_handler)(struct input_dev *dev, unsigned int type, unsigned int code, int value);
+
+struct input_dev *input_allocate_device(void) {
+	return calloc(1, sizeof(struct input_dev));
+}
+
+void input_free_device(struct input_dev *dev) {
+	free(dev);
+}
+
+int input_register_device(struct input_dev *dev) {
+	dev->registered = true;
+	return 0;
+}
+
+/**
+ * Unregister an input device. Like in the kernel the device is freed with it.
+ *
+ * @param dev The input device
+ */
+void input_unregister_device(struct input_dev *dev) {
+	dev->registered = false;
+	input_free_device(dev);
+}
+
+void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code) {
+	switch (type) {
+	case EV_KEY:
+		__set_bit(code, dev->keybit);
+		break;
+	case EV_REL:
+		__set_bit(code, dev->relbit);
+		break;
+	case EV_ABS:
+		__set_bit(code, dev->absbit);
+		break;
+	}
+	__set_bit(type, dev->evbit);
+}
+
+void input_set_abs_params(struct input_dev *dev, unsigned int axis, int min, int max, int fuzz, int flat) {
+	dev->abs_min[axis] = min;
+	dev->abs_max[axis] = max;
+	input_set_capability(dev, EV_ABS, axis);
+}
+
+void input_set_timestamp(struct input_dev *dev, ktime_t timestamp) {
+	dev->timestamp = timestamp;
+}
+
+/**
+ * Pass an event to the device, unless it does not change the state of the device.
+ *
+ * @param dev The input device
+ * @param type Type of the event
+ * @param code Code of the event
+ * @param value Value of the event
+ */
+void input_event(struct input_dev *dev, unsigned int type, unsigned int code, int value) {
+	switch (type) {
+	case EV_KEY:
+		if (!test_bit(code, dev->keybit) || test_bit(code, dev->key) == !!value) {
+			return;
+		}
+		dev->key[BIT_WORD(code)] ^= BIT_MASK(code);
+		break;
+	case EV_REL:
+		if (!test_bit(code, dev->relbit) || value == 0) {
+			return;
+		}
+		dev->rel[code] += value;
+		break;
+	case EV_ABS:
+		if (!test_bit(code, dev->absbit) || dev->abs[code] == value) {
+			return;
+		}
+		dev->abs[code] = value;
+		break;
+	case EV_SYN:
+		if (dev->pending == 0) {
+			return;
+		}
+		dev->pending = 0;
+		dev->frames++;
+		if (host_input_handler) {
+			host_input_handler(dev, type, code, value);
+		}
+		return;
+	default:
+		return;
+	}
+
+	dev->pending++;
+	dev->events++;
+	if (host_input_handler) {
+		host_input_handler(dev, type, code, value);
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * Host run of the KUnit tests for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Runs the suite of pads_kunit.c against the host input core and prints the results like KUnit, in KTAP. The suite
+ * brings its own fake bus, the time of the timing cases is CLOCK_MONOTONIC.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <time.h>
+#include <kunit/test.h>
+
+struct kunit_resource {
+	struct kunit_resource *next;
+	long long data[];
+};
+
+extern struct kunit_suite *kunit_host_suite;
+
+s64 host_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void host_delay(unsigned long ns) {
+	s64 end = host_now() + ns;
+
+	while (host_now() < end) {
+	}
+}
+
+void *kunit_kzalloc(struct kunit *test, size_t size, int gfp) {
+	struct kunit_resource *res = calloc(1, sizeof(*res) + size);
+
+	if (!res) {
+		return NULL;
+	}
+	res->next = test->resources;
+	test->resources = res;
+	return res->data;
+}
+
+void kunit_fail(struct kunit *test, const char *file, int line, const char *fmt, ...) {
+	va_list args;
+
+	test->failed = true;
+	printf("    # %s: %s:%d\n    ", test->name, file, line);
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+	printf("\n");
+}
+
+/**
+ * Run a test case, the exit function runs also when the init function or the case failed.
+ *
+ * @param suite The suite
+ * @param test_case The test case
+ * @return true if the case passed
+ */
+static bool kunit_run_case(struct kunit_suite *suite, struct kunit_case *test_case) {
+	struct kunit test = { .name = test_case->name };
+	struct kunit_resource *res;
+	int status;
+
+	if (setjmp(test.abort) == 0) {
+		status = suite->init ? suite->init(&test) : 0;
+		if (status != 0) {
+			kunit_fail(&test, __FILE__, __LINE__, "init failed, %d", status);
+		} else {
+			test_case->run_case(&test);
+		}
+	}
+	if (suite->exit) {
+		suite->exit(&test);
+	}
+
+	while (test.resources) {
+		res = test.resources;
+		test.resources = res->next;
+		free(res);
+	}
+	return !test.failed;
+}
+
+int main(void) {
+	struct kunit_suite *suite = kunit_host_suite;
+	struct kunit_case *test_case;
+	int n = 0, i = 0, failed = 0;
+	bool passed;
+
+	for (test_case = suite->test_cases; test_case->run_case; test_case++) {
+		n++;
+	}
+
+	printf("KTAP version 1\n1..1\n    KTAP version 1\n    # Subtest: %s\n    1..%d\n", suite->name, n);
+	for (test_case = suite->test_cases; test_case->run_case; test_case++) {
+		passed = kunit_run_case(suite, test_case);
+		failed += !passed;
+		printf("    %s %d %s\n", passed ? "ok" : "not ok", ++i, test_case->name);
+	}
+	printf("%s 1 %s\n", failed ? "not ok" : "ok", suite->name);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
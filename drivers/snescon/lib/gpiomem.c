@@ -0,0 +1,142 @@
+/*
+ * /dev/gpiomem backend for the NES, SNES, gamepad library for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Replaces gpio.c in the library. /dev/gpiomem maps the GPIO registers without root, the register access is shared
+ * with the module through gpio_regs.h and the SoC is detected by gpio_common.c, from /proc/device-tree. udelay spins on CLOCK_MONOTONIC, sleeping is far too coarse for the 6 us bus timing.
+ */
+
+#define pr_fmt(fmt) "snescon: " fmt
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include "snescon_host.h"
+#include <linux/of.h>
+#include "gpio.h"
+#include "gpio_regs.h"
+
+#define GPIOMEM "/dev/gpiomem"
+#define GPIOMEM_SIZE 4096
+#define COMPATIBLE "/proc/device-tree/compatible"
+
+const bool gpio_atomic_direction = true;
+
+static volatile unsigned *gpio;	// I/O access.
+static const struct gpio_soc *soc;
+
+s64 host_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (s64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void host_delay(unsigned long ns) {
+	s64 end = host_now() + ns;
+
+	while (host_now() < end) {
+	}
+}
+
+void gpio_set(unsigned int g_bit) {
+	*(gpio + GPSET) = g_bit;
+}
+
+void gpio_clear(unsigned int g_bit) {
+	*(gpio + GPCLR) = g_bit;
+}
+
+void gpio_input(unsigned int g_bit) {
+	gpio_regs_input(gpio, g_bit);
+}
+
+void gpio_output(unsigned int g_bit) {
+	gpio_regs_output(gpio, g_bit);
+}
+
+void gpio_enable_pull_up(unsigned int g_bit) {
+	gpio_regs_pull_up(gpio, g_bit, soc->pull_2711);
+}
+
+/**
+ * Check if the machine is compatible with a device tree compatible string, for gpio_soc_detect in gpio_common.c.
+ * The compatible strings are NUL separated.
+ *
+ * @param compat The compatible string
+ * @return true if the machine is compatible
+ */
+bool of_machine_is_compatible(const char *compat) {
+	char compatible[256];
+	size_t i, len;
+	FILE *f = fopen(COMPATIBLE, "r");
+
+	if (!f) {
+		return false;
+	}
+	len = fread(compatible, 1, sizeof(compatible) - 1, f);
+	fclose(f);
+	compatible[len] = 0;
+
+	for (i = 0; i < len; i += strlen(compatible + i) + 1) {
+		if (!strcmp(compatible + i, compat)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned char gpio_read(unsigned int g_bit) {
+	return !!(g_bit & *(gpio + GPLEV));
+}
+
+unsigned int gpio_read_all(void) {
+	return ~(*(gpio + GPLEV));
+}
+
+/**
+ * Map the GPIO registers.
+ *
+ * @param g_ids The GPIOs used by the library
+ * @param n Number of GPIOs
+ * @return Status
+ */
+int gpio_init(const unsigned int *g_ids, unsigned char n) {
+	void *map;
+	int fd, status;
+
+	soc = gpio_soc_detect();
+	if (!soc) {
+		return -ENODEV;
+	}
+
+	fd = open(GPIOMEM, O_RDWR | O_SYNC | O_CLOEXEC);
+	if (fd < 0) {
+		status = -errno;
+		pr_err("Could not open " GPIOMEM ".\n");
+		return status;
+	}
+
+	map = mmap(NULL, GPIOMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	status = -errno;
+	close(fd);
+	if (map == MAP_FAILED) {
+		pr_err("Could not map " GPIOMEM ".\n");
+		return status;
+	}
+
+	gpio = map;
+	return 0;
+}
+
+void gpio_exit(void) {
+	if (gpio) {
+		munmap((void *)gpio, GPIOMEM_SIZE);
+		gpio = NULL;
+	}
+}
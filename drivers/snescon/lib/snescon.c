@@ -0,0 +1,326 @@
+/*
+ * NES, SNES, gamepad library for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+#define _GNU_SOURCE
+#define pr_fmt(fmt) "snescon: " fmt
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "snescon_host.h"
+#include "gpio.h"
+#include "pads.h"
+#include "snescon.h"
+#include "uinput.h"
+
+#define REFRESH_RATE 100
+
+_Static_assert(SNESCON_PADS == NUMBER_OF_INPUT_DEVICES, "snescon_state.pad must hold all pads of the driver");
+_Static_assert(SNESCON_GPIOS == MAX_NUMBER_OF_GPIOS, "snescon_options.gpio must hold all GPIOs of the driver");
+_Static_assert(SNESCON_MICE == NUMBER_OF_MICE, "snescon_state.mouse_buttons must hold all mice of the driver");
+
+// Buttons of the pads in the order of the driver, see pads.c
+static const long btn_label[] = { BTN_B, BTN_Y, BTN_SELECT, BTN_START, BTN_A, BTN_X, BTN_TL, BTN_TR };
+
+static struct pads_config cfg = {
+	.device_name = "SNES pad",
+	.n_gpios = NUMBER_OF_GPIOS,
+};
+
+static pthread_t thread;
+static bool running;
+
+// The state is published with a sequence count, so the polling thread never waits for a reader.
+static u32 state_seq;
+static struct snescon_state state;
+
+/**
+ * Fill in the default options: the default GPIOs of the driver, 100 polls per second and no uinput devices.
+ * port2_d3 and port2_d4 default to GPIO 17 and 27, but are not used until n_gpios is set to 8.
+ *
+ * @param opt The options
+ */
+void snescon_default_options(struct snescon_options *opt) {
+	static const unsigned int gpio_id[] = { 2, 3, 4, 7, 10, 11, 17, 27 };
+
+	memset(opt, 0, sizeof(*opt));
+	memcpy(opt->gpio, gpio_id, sizeof(gpio_id));
+	opt->n_gpios = NUMBER_OF_GPIOS;
+	opt->mouse_speed = 1;
+	opt->rate = REFRESH_RATE;
+	opt->cpu = -1;
+}
+
+/**
+ * Pass the events of the devices on to their uinput devices.
+ */
+static void snescon_forward(struct input_dev *dev, unsigned int type, unsigned int code, int value) {
+	if (dev->host) {
+		uinput_emit((int)(intptr_t)dev->host - 1, type, code, value);
+	}
+}
+
+/**
+ * Create a uinput device for an input device of the pads.
+ *
+ * @param dev The input device
+ * @return Status
+ */
+static int snescon_uinput(struct input_dev *dev) {
+	struct uinput_caps caps = {
+		.name = dev->name,
+		.bustype = dev->id.bustype,
+		.vendor = dev->id.vendor,
+		.product = dev->id.product,
+		.version = dev->id.version,
+		.keybit = dev->keybit,
+		.relbit = dev->relbit,
+		.absbit = dev->absbit,
+		.abs_min = dev->abs_min,
+		.abs_max = dev->abs_max,
+	};
+	int fd = uinput_create(&caps);
+
+	if (fd < 0) {
+		return fd;
+	}
+	dev->host = (void *)(intptr_t)(fd + 1);
+	return 0;
+}
+
+/**
+ * Pack the buttons and the direction of a pad.
+ *
+ * @param dev The input device of the pad
+ * @return The packed buttons
+ */
+static u16 snescon_pack(const struct input_dev *dev) {
+	u16 buttons = 0;
+	int j;
+
+	for (j = 0; j < 8; j++) {
+		if (test_bit(btn_label[j], dev->key)) {
+			buttons |= 1 << j;
+		}
+	}
+	buttons |= (dev->abs[ABS_Y] < 0) ? SNESCON_UP : (dev->abs[ABS_Y] > 0) ? SNESCON_DOWN : 0;
+	buttons |= (dev->abs[ABS_X] < 0) ? SNESCON_LEFT : (dev->abs[ABS_X] > 0) ? SNESCON_RIGHT : 0;
+	return buttons;
+}
+
+/**
+ * Publish the state of the devices after a poll.
+ *
+ * @param cap The capture that was decoded
+ */
+static void snescon_publish(const struct pads_capture *cap) {
+	u32 seq = __atomic_load_n(&state_seq, __ATOMIC_RELAXED);
+	int i;
+
+	__atomic_store_n(&state_seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	state.polls++;
+	state.players = cfg.player_mode < 2 ? 2 : cfg.player_mode;
+	state.latch_ns = cap->latch;
+	for (i = 0; i < SNESCON_PADS; i++) {
+		// Pads 6 - 8 only exist with 8 GPIOs
+		state.pad[i] = cfg.pad[i] ? snescon_pack(cfg.pad[i]) : 0;
+	}
+	for (i = 0; cfg.mouse_enabled && i < SNESCON_MICE; i++) {
+		state.mouse_buttons[i] = (test_bit(BTN_LEFT, cfg.mouse[i]->key) ? SNESCON_MOUSE_LEFT : 0) |
+					 (test_bit(BTN_RIGHT, cfg.mouse[i]->key) ? SNESCON_MOUSE_RIGHT : 0);
+		state.mouse_x[i] = cfg.mouse[i]->rel[REL_X];
+		state.mouse_y[i] = cfg.mouse[i]->rel[REL_Y];
+	}
+
+	__atomic_store_n(&state_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the state of the pads after the last poll.
+ *
+ * @param out Set to the state
+ */
+void snescon_get_state(struct snescon_state *out) {
+	u32 seq;
+
+	do {
+		seq = __atomic_load_n(&state_seq, __ATOMIC_ACQUIRE);
+		memcpy(out, &state, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&state_seq, __ATOMIC_RELAXED));
+}
+
+/**
+ * The polling thread. Polls the bus at a fixed rate, the next poll is due a period after the previous one was due.
+ */
+static void *snescon_poll(void *arg) {
+	long period = (long)(intptr_t)arg;
+	struct pads_capture cap;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		pads_acquire(&cfg, &cap);
+		pads_update(&cfg, &cap);
+		snescon_publish(&cap);
+
+		next.tv_nsec += period;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+	return NULL;
+}
+
+/**
+ * Destroy the uinput devices.
+ */
+static void snescon_uinput_remove(void) {
+	struct input_dev *devs[SNESCON_PADS + SNESCON_MICE];
+	int i;
+
+	for (i = 0; i < SNESCON_PADS; i++) {
+		devs[i] = cfg.pad[i];
+	}
+	for (i = 0; i < SNESCON_MICE; i++) {
+		devs[SNESCON_PADS + i] = cfg.mouse[i];
+	}
+
+	for (i = 0; i < SNESCON_PADS + SNESCON_MICE; i++) {
+		if (devs[i] && devs[i]->host) {
+			uinput_destroy((int)(intptr_t)devs[i]->host - 1);
+			devs[i]->host = NULL;
+		}
+	}
+	host_input_handler = NULL;
+}
+
+/**
+ * Set up the bus and start polling it.
+ *
+ * @param opt The options, see snescon_default_options
+ * @return 0 on success, otherwise a negative error code
+ */
+int snescon_start(const struct snescon_options *opt) {
+	pthread_attr_t attr;
+	struct sched_param param;
+	cpu_set_t cpus;
+	int i, j, status;
+
+	if (opt->n_gpios != NUMBER_OF_GPIOS && opt->n_gpios != MAX_NUMBER_OF_GPIOS) {
+		pr_err("Invalid number of GPIOs %u, %d or %d are supported.\n", opt->n_gpios, NUMBER_OF_GPIOS,
+		       MAX_NUMBER_OF_GPIOS);
+		return -EINVAL;
+	}
+	for (i = 0; i < MAX_NUMBER_OF_GPIOS; i++) {
+		if (i >= opt->n_gpios) {
+			cfg.gpio[i] = 0;
+			continue;
+		}
+		if (opt->gpio[i] > 27) {
+			pr_err("Invalid GPIO %u.\n", opt->gpio[i]);
+			return -EINVAL;
+		}
+		for (j = 0; j < i; j++) {
+			if (opt->gpio[j] == opt->gpio[i]) {
+				pr_err("GPIO %u is used more than once.\n", opt->gpio[i]);
+				return -EINVAL;
+			}
+		}
+		cfg.gpio[i] = 1 << opt->gpio[i];
+	}
+	if (opt->rate == 0 || opt->rate > 1000) {
+		pr_err("Invalid rate %u, 1 - 1000 polls per second are supported.\n", opt->rate);
+		return -EINVAL;
+	}
+	cfg.n_gpios = opt->n_gpios;
+	cfg.multitap_enabled = opt->multitap;
+	cfg.fourscore_enabled = opt->fourscore;
+	cfg.mouse_enabled = opt->mouse;
+	cfg.mouse_speed = opt->mouse_speed;
+
+	status = gpio_init(opt->gpio, cfg.n_gpios);
+	if (status != 0) {
+		return status;
+	}
+
+	status = pads_setup(&cfg);
+	if (status != 0) {
+		goto err_gpio;
+	}
+	status = pads_register(&cfg);
+	if (status != 0) {
+		goto err_gpio;
+	}
+
+	for (i = 0; opt->uinput && i < SNESCON_PADS && status == 0; i++) {
+		if (cfg.pad[i]) {
+			status = snescon_uinput(cfg.pad[i]);
+		}
+	}
+	for (i = 0; opt->uinput && cfg.mouse_enabled && i < SNESCON_MICE && status == 0; i++) {
+		status = snescon_uinput(cfg.mouse[i]);
+	}
+	if (status != 0) {
+		goto err_pads;
+	}
+	host_input_handler = opt->uinput ? snescon_forward : NULL;
+
+	pthread_attr_init(&attr);
+	if (opt->priority > 0) {
+		// Keep the polling thread from page faulting.
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+			pr_warn("Could not lock memory.\n");
+		}
+		param.sched_priority = opt->priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+	if (opt->cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(opt->cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+
+	__atomic_store_n(&running, true, __ATOMIC_RELEASE);
+	status = -pthread_create(&thread, &attr, snescon_poll, (void *)(intptr_t)(1000000000 / opt->rate));
+	pthread_attr_destroy(&attr);
+	if (status != 0) {
+		__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+		pr_err("Could not start the polling thread, real-time scheduling needs CAP_SYS_NICE.\n");
+		goto err_pads;
+	}
+	return 0;
+
+err_pads:
+	snescon_uinput_remove();
+	pads_remove(&cfg);
+err_gpio:
+	gpio_exit();
+	return status;
+}
+
+/**
+ * Stop polling and release the bus.
+ */
+void snescon_stop(void) {
+	if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+
+	snescon_uinput_remove();
+	pads_remove(&cfg);
+	gpio_exit();
+}
@@ -0,0 +1,90 @@
+/*
+ * NES, SNES, gamepad library for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * Runs the capture and decode code of the driver in userspace, against /dev/gpiomem, for systems that can not load
+ * the module. The bus is polled from a thread of its own and the state of the pads is read with snescon_get_state,
+ * optionally the pads also show up as uinput devices, like the devices of the driver.
+ *
+ * There is one bus per process, all functions are thread safe except snescon_start and snescon_stop.
+ */
+
+#ifndef SNESCON_LIB_H_
+#define SNESCON_LIB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sizes of the driver, NUMBER_OF_INPUT_DEVICES, MAX_NUMBER_OF_GPIOS and NUMBER_OF_MICE in pads.h
+#define SNESCON_PADS 8
+#define SNESCON_GPIOS 8
+#define SNESCON_MICE 2
+
+// Buttons in snescon_state.pad
+#define SNESCON_B	(1 << 0)
+#define SNESCON_Y	(1 << 1)
+#define SNESCON_SELECT	(1 << 2)
+#define SNESCON_START	(1 << 3)
+#define SNESCON_A	(1 << 4)
+#define SNESCON_X	(1 << 5)
+#define SNESCON_L	(1 << 6)
+#define SNESCON_R	(1 << 7)
+#define SNESCON_UP	(1 << 8)
+#define SNESCON_DOWN	(1 << 9)
+#define SNESCON_LEFT	(1 << 10)
+#define SNESCON_RIGHT	(1 << 11)
+
+// Buttons in snescon_state.mouse_buttons
+#define SNESCON_MOUSE_LEFT	(1 << 0)
+#define SNESCON_MOUSE_RIGHT	(1 << 1)
+
+/*
+ * Options of the bus, see snescon_default_options.
+ *
+ * gpio: <clk, latch, port1_d0 (data1), port2_d0 (data2), port2_d1 (data4), port2_pp (data6), port2_d3, port2_d4>, as
+ * GPIO numbers. port2_d3 and port2_d4 connect a second Four Score or Multitap, they are only used when n_gpios is 8.
+ */
+struct snescon_options {
+	unsigned int gpio[SNESCON_GPIOS];
+	unsigned int n_gpios;	// 6, or 8 for a second adapter
+	bool multitap;
+	bool fourscore;
+	bool mouse;
+	unsigned int mouse_speed;	// 0 = slow, 1 = normal, 2 = fast
+	unsigned int rate;	// Polls per second
+	int cpu;	// CPU the polling thread is pinned to, -1 to let it run anywhere
+	int priority;	// SCHED_FIFO priority of the polling thread, 0 for the normal scheduler
+	bool uinput;	// Also report the pads as uinput devices
+};
+
+/*
+ * State of the pads after a poll.
+ */
+struct snescon_state {
+	uint32_t polls;	// Number of polls since snescon_start
+	uint8_t players;	// 2, 4 with a Four Score, 5 with a Multitap or 8 with two of them
+	int64_t latch_ns;	// Time in ns (CLOCK_MONOTONIC) when the bus was latched
+	uint16_t pad[SNESCON_PADS];
+	uint8_t mouse_buttons[SNESCON_MICE];
+	int32_t mouse_x[SNESCON_MICE];	// Sum of all motion, positive for right
+	int32_t mouse_y[SNESCON_MICE];	// Sum of all motion, positive for down
+};
+
+void snescon_default_options(struct snescon_options *opt);
+int snescon_start(const struct snescon_options *opt);
+void snescon_stop(void);
+void snescon_get_state(struct snescon_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SNESCON_LIB_H_ */
@@ -0,0 +1,107 @@
+/*
+ * uinput output of the NES, SNES, gamepad library for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#include "uinput.h"
+
+#define UINPUT "/dev/uinput"
+#define BITS_PER_LONG (8 * sizeof(long))
+
+static int test_bit(int nr, const unsigned long *addr) {
+	return !!(addr[nr / BITS_PER_LONG] & (1UL << (nr % BITS_PER_LONG)));
+}
+
+/**
+ * Create a uinput device.
+ *
+ * @param caps Capabilities of the device
+ * @return File descriptor of the device, or a negative error code
+ */
+int uinput_create(const struct uinput_caps *caps) {
+	struct uinput_setup setup;
+	struct uinput_abs_setup abs;
+	int fd, code, status = 0;
+
+	fd = open(UINPUT, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		status = -errno;
+		fprintf(stderr, "snescon: Could not open " UINPUT ".\n");
+		return status;
+	}
+
+	for (code = 0; code < KEY_CNT && status == 0; code++) {
+		if (test_bit(code, caps->keybit)) {
+			status = ioctl(fd, UI_SET_EVBIT, EV_KEY) | ioctl(fd, UI_SET_KEYBIT, code);
+		}
+	}
+
+	for (code = 0; code < REL_CNT && status == 0; code++) {
+		if (test_bit(code, caps->relbit)) {
+			status = ioctl(fd, UI_SET_EVBIT, EV_REL) | ioctl(fd, UI_SET_RELBIT, code);
+		}
+	}
+
+	for (code = 0; code < ABS_CNT && status == 0; code++) {
+		if (test_bit(code, caps->absbit)) {
+			memset(&abs, 0, sizeof(abs));
+			abs.code = code;
+			abs.absinfo.minimum = caps->abs_min[code];
+			abs.absinfo.maximum = caps->abs_max[code];
+			status = ioctl(fd, UI_SET_EVBIT, EV_ABS) | ioctl(fd, UI_SET_ABSBIT, code) |
+				 ioctl(fd, UI_ABS_SETUP, &abs);
+		}
+	}
+
+	if (status == 0) {
+		memset(&setup, 0, sizeof(setup));
+		snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "%s", caps->name);
+		setup.id.bustype = caps->bustype;
+		setup.id.vendor = caps->vendor;
+		setup.id.product = caps->product;
+		setup.id.version = caps->version;
+		status = ioctl(fd, UI_DEV_SETUP, &setup) | ioctl(fd, UI_DEV_CREATE);
+	}
+
+	if (status != 0) {
+		status = -errno;
+		fprintf(stderr, "snescon: Could not create uinput device %s.\n", caps->name);
+		close(fd);
+		return status;
+	}
+	return fd;
+}
+
+/**
+ * Pass an event to a uinput device.
+ *
+ * @param fd The device
+ * @param type Type of the event
+ * @param code Code of the event
+ * @param value Value of the event
+ */
+void uinput_emit(int fd, unsigned int type, unsigned int code, int value) {
+	struct input_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+	if (write(fd, &ev, sizeof(ev)) != sizeof(ev)) {
+		// The reader is too slow, the event is dropped like on a full evdev buffer.
+	}
+}
+
+void uinput_destroy(int fd) {
+	ioctl(fd, UI_DEV_DESTROY);
+	close(fd);
+}
@@ -0,0 +1,32 @@
+/*
+ * uinput output of the NES, SNES, gamepad library for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+#ifndef SNESCON_UINPUT_H_
+#define SNESCON_UINPUT_H_
+
+/*
+ * Capabilities of a device. The bitmaps are indexed by event code like in the kernel.
+ * uinput.c includes the system linux/ headers, so it can not see struct input_dev of the host build.
+ */
+struct uinput_caps {
+	const char *name;
+	unsigned short bustype;
+	unsigned short vendor;
+	unsigned short product;
+	unsigned short version;
+	const unsigned long *keybit;
+	const unsigned long *relbit;
+	const unsigned long *absbit;
+	const int *abs_min;
+	const int *abs_max;
+};
+
+int uinput_create(const struct uinput_caps *caps);
+void uinput_emit(int fd, unsigned int type, unsigned int code, int value);
+void uinput_destroy(int fd);
+
+#endif /* SNESCON_UINPUT_H_ */
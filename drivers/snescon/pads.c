@@ -0,0 +1,1175 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/device.h>
+#include <linux/ktime.h>
+#include <linux/version.h>
+#include "gpio.h"
+#include "pads.h"
+
+/* _____          _     
+  |  __ \        | |    
+  | |__) |_ _  __| |___ 
+  |  ___/ _` |/ _` / __|
+  | |  | (_| | (_| \__ \
+  |_|   \__,_|\__,_|___/
+*/
+
+// Buttons found on the SNES gamepad
+static const long btn_label[] = { BTN_B, BTN_Y, BTN_SELECT, BTN_START, BTN_A, BTN_X, BTN_TL, BTN_TR };
+
+// The order that the buttons of the SNES gamepad are stored in the byte string
+static const unsigned char btn_index[] = { 0, 1, 2, 3, 8, 9, 10, 11 };
+
+/**
+ * Check if a second Multitap can be connected. It is on port 1, port2_d3 and port2_d4 are its port1_d1 and port1_pp.
+ *
+ * @param cfg The pad configuration
+ * @return true if the second Multitap is read while the first is connected
+ */
+static bool multitap_dual(const struct pads_config *cfg) {
+	return cfg->multitap_enabled && cfg->n_gpios >= MAX_NUMBER_OF_GPIOS;
+}
+
+/**
+ * Check if a second Four Score can be connected. It is on port 3 and 4, port2_d3 and port2_d4 are its data lines.
+ * A second Multitap takes precedence, it drives port2_d4.
+ *
+ * @param cfg The pad configuration
+ * @return true if the second Four Score is read while the first is connected
+ */
+static bool fourscore_dual(const struct pads_config *cfg) {
+	return cfg->fourscore_enabled && !cfg->multitap_enabled && cfg->n_gpios >= MAX_NUMBER_OF_GPIOS;
+}
+
+/**
+ * Get the number of bits to clock out of the devices that are not behind a Multitap.
+ *
+ * @param cfg The pad configuration
+ * @return The number of bits
+ */
+static int pads_bits(const struct pads_config *cfg) {
+	// The SNES Mouse report is 32 bits long, only clock out the extra bits when a mouse is connected.
+	// A paddle on port 2 rules out the Four Score, so its signature does not need to be read.
+	if (cfg->mouse_ports) {
+		return BITS_LENGTH_MOUSE;
+	} else if (cfg->paddle_enabled) {
+		return BITS_LENGTH_PADDLE;
+	}
+	return BITS_LENGTH;
+}
+
+/**
+ * Read the data pins of all connected devices.
+ *
+ * @param cfg The pad configuration
+ * @param cap Capture to store the read data in
+ */
+static void pads_read(struct pads_config *cfg, struct pads_capture *cap) {
+	int i, bits = pads_bits(cfg);
+	unsigned int clk, latch;
+	u32 *data = cap->data;
+
+	clk = cfg->gpio[0];
+	latch = cfg->gpio[1];
+
+	gpio_set(clk | latch);
+	cap->latch = ktime_to_ns(ktime_get());
+	cap->type = cfg->mouse_ports ? PADS_CAPTURE_MOUSE : PADS_CAPTURE_STANDARD;
+	udelay(DELAY * 2);
+
+	if (cfg->mouse_cycle) {
+		// A clock pulse while latched cycles the sensitivity of SNES mice.
+		gpio_clear(clk);
+		udelay(DELAY);
+		gpio_set(clk);
+		udelay(DELAY);
+		cfg->mouse_cycle = false;
+	}
+	gpio_clear(latch);
+
+	for (i = 0; i < bits; i++) {
+		udelay (DELAY);
+		gpio_clear(clk);
+		data[i] = gpio_read_all();
+		udelay(DELAY);
+		gpio_set(clk);
+	}
+
+	for (; i < BUFFER_SIZE; i++) {
+		data[i] = 0;
+	}
+}
+
+/**
+ * Read data pins of SNES Multitap and SNES pad connected to port 1. A second Multitap on port 1 is read in the same
+ * transaction, its PP line is switched together with the one of port 2.
+ *
+ * @param cfg The pad configuration
+ * @param cap Capture to store the read data in
+ * @param dual Set if a second Multitap is connected to port 1
+ */
+static void pads_read_multitap(struct pads_config *cfg, struct pads_capture *cap, bool dual) {
+	int i;
+	unsigned int clk, latch, pp;
+	u32 *data = cap->data;
+
+	clk = cfg->gpio[0];
+	latch = cfg->gpio[1];
+	pp = cfg->gpio[5];
+	if (dual) {
+		pp |= cfg->gpio[7];
+	}
+
+	gpio_set(clk | latch);
+	cap->latch = ktime_to_ns(ktime_get());
+	cap->type = dual ? PADS_CAPTURE_MULTITAP_DUAL : PADS_CAPTURE_MULTITAP;
+	udelay(DELAY * 2);
+	gpio_clear(latch);
+
+	for (i = 0; i < BITS_LENGTH_MULTITAP / 2; i++) {
+		udelay (DELAY);
+		gpio_clear(clk);
+		data[i] = gpio_read_all();
+		udelay(DELAY);
+		gpio_set(clk);
+	}
+
+	// Set PP low
+	gpio_clear(pp);
+
+	for (; i < BITS_LENGTH_MULTITAP; i++) {
+		udelay (DELAY);
+		gpio_clear(clk);
+		data[i] = gpio_read_all();
+		udelay(DELAY);
+		gpio_set(clk);
+	}
+
+	// Set PP high
+	gpio_set(pp);
+}
+
+/**
+ * Get the pins used to detect SNES Multitaps. Port 1 is only checked when a second Multitap can be connected, both
+ * ports are then checked in the same pass.
+ *
+ * @param cfg The pad configuration
+ * @param d0 Set to the D0 pins, which are driven
+ * @param d1 Set to the D1 pins, which are read
+ */
+static void multitap_pins(const struct pads_config *cfg, unsigned int *d0, unsigned int *d1) {
+	*d0 = cfg->gpio[3];
+	*d1 = cfg->gpio[4];
+	if (multitap_dual(cfg)) {
+		*d0 |= cfg->gpio[2];
+		*d1 |= cfg->gpio[6];
+	}
+}
+
+/**
+ * Get the ports with a SNES Multitap from the D1 levels read while D0 was driven high and low.
+ *
+ * @param cfg The pad configuration
+ * @param high D1 pins that stayed high while D0 was high
+ * @param low D1 pins that were low while D0 was low
+ * @return The D0 pins of the ports with a SNES Multitap, port2_d0 and port1_d0
+ */
+static unsigned int multitap_ports(const struct pads_config *cfg, unsigned int high, unsigned int low) {
+	unsigned int ports = 0;
+
+	// D1 follows D0 through a Multitap. Without one it stays high, it is pulled up.
+	if (high & low & cfg->gpio[4]) {
+		ports |= cfg->gpio[3];
+	}
+	if (multitap_dual(cfg) && (high & low & cfg->gpio[6])) {
+		ports |= cfg->gpio[2];
+	}
+	return ports;
+}
+
+/**
+ * Check which ports a SNES Multitap is connected to.
+ *
+ * @param cfg The pad configuration
+ * @return The D0 pins of the ports with a SNES Multitap, port2_d0 and port1_d0
+ */
+static unsigned int multitap_connected(struct pads_config *cfg) {
+	int i;
+	unsigned int clk, d0, d1, levels, high, low = 0;
+
+	// Store GPIOs in variables
+	clk = cfg->gpio[0];
+	multitap_pins(cfg, &d0, &d1);
+	high = d1;
+
+	// Set D0 to output
+	gpio_output(d0);
+
+	// Set D0 high
+	gpio_set(d0);
+	gpio_set(clk);
+	udelay (DELAY);
+
+	// Read D1 eight times
+	for (i = 0; i < 8; i++) {
+		udelay(DELAY);
+		gpio_clear(clk);
+
+		// Check if D1 is low. Keep clocking, so clk and D0 are left as they were.
+		high &= ~gpio_read_all();
+		udelay(DELAY);
+		gpio_set(clk);
+	}
+
+	// Set D0 low
+	gpio_clear(d0);
+
+	// Read D1 eight times
+	for (i = 0; i < 8; i++) {
+		udelay(DELAY);
+		gpio_clear(clk);
+		levels = ~gpio_read_all();
+		low |= d1 & ~levels;
+		udelay(DELAY);
+		gpio_set(clk);
+	}
+
+	// Set D0 to input
+	gpio_input(d0);
+
+	return multitap_ports(cfg, high, low);
+}
+
+/**
+ * Check if a NES Four Score is connected. Its signature follows the pads, 0x08 on the first port and 0x04 on the
+ * second.
+ *
+ * @param g1 Data pin of the first port of the Four Score, port1_d0 or port3_d0
+ * @param g2 Data pin of the second port of the Four Score, port2_d0 or port4_d0
+ * @param data The read data
+ * @return 1 if a NES Four Score is connected, otherwise 0
+ */
+static unsigned char fourscore_connected(unsigned int g1, unsigned int g2, const u32 *data) {
+	return !(g1 & data[16]) &&
+	       !(g1 & data[17]) &&
+	       !(g1 & data[18]) &&
+	        (g1 & data[19]) &&
+	       !(g1 & data[20]) &&
+	       !(g1 & data[21]) &&
+	       !(g1 & data[22]) &&
+	       !(g1 & data[23]) &&
+	       !(g2 & data[16]) &&
+	       !(g2 & data[17]) &&
+	        (g2 & data[18]) &&
+	       !(g2 & data[19]) &&
+	       !(g2 & data[20]) &&
+	       !(g2 & data[21]) &&
+	       !(g2 & data[22]) &&
+	       !(g2 & data[23]);
+}
+
+/**
+ * Stamp the next events of a device with the time the input was sampled, rather than the time they are synced.
+ * Event timestamps can only be set on kernel 5.4 and newer, older kernels fall back to the sync time.
+ *
+ * @param dev The input device
+ * @param ns Time in ns (CLOCK_MONOTONIC), normally when the bus was latched
+ */
+static void pads_timestamp(struct input_dev *dev, s64 ns) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+	input_set_timestamp(dev, ns_to_ktime(ns));
+#endif
+}
+
+/**
+ * Check if a SNES Mouse is connected to a data pin. The mouse identifies itself with 0001 in bits 12 - 15.
+ *
+ * @param g The data pin
+ * @param data The read data
+ * @return 1 if a SNES Mouse is connected, otherwise 0
+ */
+static unsigned char mouse_connected(unsigned int g, const u32 *data) {
+	return !(g & data[12]) && !(g & data[13]) && !(g & data[14]) && (g & data[15]);
+}
+
+/**
+ * Decode one axis of SNES Mouse motion. The direction bit is followed by a 7 bit magnitude, most significant bit first.
+ *
+ * @param g The data pin
+ * @param data The read data
+ * @param dir Index of the direction bit, which is set for up and left motion
+ * @return The motion, negative for up and left
+ */
+static int mouse_delta(unsigned int g, const u32 *data, int dir) {
+	int i, delta = 0;
+
+	for (i = dir + 1; i < dir + 8; i++) {
+		delta = (delta << 1) | !!(g & data[i]);
+	}
+	return (g & data[dir]) ? -delta : delta;
+}
+
+/**
+ * Track the SNES mice on port 1 and 2. Detects connected mice, accumulates their motion and requests
+ * a sensitivity cycle when a mouse is not at the requested sensitivity.
+ *
+ * The motion counters of the mouse are reset on every latch and saturate at 127, so every capture
+ * must be tracked, also the ones that are not reported.
+ *
+ * @param cfg The pad configuration
+ * @param cap The capture to track
+ */
+void mouse_track(struct pads_config *cfg, const struct pads_capture *cap) {
+	const u32 *data = cap->data;
+	unsigned int g, speed;
+	unsigned char i;
+
+	for (i = 0; i < NUMBER_OF_MICE; i++) {
+		g = cfg->gpio[i + 2];
+
+		// Bits 8 - 15 of a Four Score carry player 3 and 4, Right alone reads like the signature of a mouse.
+		if (!cfg->mouse_enabled || cap->type == PADS_CAPTURE_MULTITAP || cap->type == PADS_CAPTURE_MULTITAP_DUAL ||
+		    (cfg->fourscore_enabled && fourscore_connected(cfg->gpio[2], cfg->gpio[3], data)) ||
+		    !mouse_connected(g, data)) {
+			cfg->mouse_ports &= ~g;
+			continue;
+		}
+		cfg->mouse_ports |= g;
+
+		// Motion is only available when all 32 bits were read.
+		if (cap->type != PADS_CAPTURE_MOUSE) {
+			continue;
+		}
+
+		cfg->mouse_dy[i] += mouse_delta(g, data, 16);
+		cfg->mouse_dx[i] += mouse_delta(g, data, 24);
+
+		speed = (!!(g & data[10]) << 1) | !!(g & data[11]);
+		if (speed != min_t(unsigned int, cfg->mouse_speed, MOUSE_SPEEDS - 1)) {
+			cfg->mouse_cycle = true;
+		}
+	}
+}
+
+/**
+ * Report the buttons and the accumulated motion of a SNES Mouse.
+ *
+ * @param cfg The pad configuration
+ * @param i Index of the mouse
+ * @param data The read data
+ */
+static void mouse_report(struct pads_config *cfg, unsigned char i, const u32 *data) {
+	struct input_dev *dev = cfg->mouse[i];
+	unsigned int g = cfg->gpio[i + 2];
+
+	pads_timestamp(dev, cfg->latch);
+	input_report_key(dev, BTN_RIGHT, g & data[8]);
+	input_report_key(dev, BTN_LEFT, g & data[9]);
+	input_report_rel(dev, REL_X, cfg->mouse_dx[i]);
+	input_report_rel(dev, REL_Y, cfg->mouse_dy[i]);
+	input_sync(dev);
+
+	cfg->mouse_dx[i] = 0;
+	cfg->mouse_dy[i] = 0;
+}
+
+/**
+ * Report the position and button of an Arkanoid Vaus paddle on port 2. The position is shifted out as 8 bits,
+ * most significant bit first, on port2_d1. The button is read from port2_d3 when that GPIO is configured.
+ *
+ * @param cfg The pad configuration
+ * @param data The read data
+ */
+static void paddle_report(struct pads_config *cfg, const u32 *data) {
+	struct input_dev *dev = cfg->paddle;
+	unsigned int g = cfg->gpio[4];
+	int i, position = 0;
+
+	for (i = 0; i < PADDLE_BITS; i++) {
+		position = (position << 1) | !!(g & data[i]);
+	}
+
+	pads_timestamp(dev, cfg->latch);
+	input_report_abs(dev, ABS_X, position);
+	if (cfg->n_gpios > 6) {
+		input_report_key(dev, BTN_A, cfg->gpio[6] & data[0]);
+	}
+	input_sync(dev);
+}
+
+/**
+ * Report the trigger and light sense of a NES Zapper on port 2. The Zapper is not clocked, D3 reads 0 while light
+ * is detected and D4 reads 1 while the trigger is pulled. Only changes are reported, each stamped with the time the
+ * levels were sampled, so a light transition can be placed within the frame.
+ *
+ * @param cfg The pad configuration
+ * @param levels Negated GPIO level register
+ * @param ns Time in ns (CLOCK_MONOTONIC) when levels was sampled
+ */
+void zapper_report(struct pads_config *cfg, u32 levels, s64 ns) {
+	struct input_dev *dev = cfg->zapper;
+	bool light = !(cfg->gpio[6] & levels);
+	bool trigger = !!(cfg->gpio[7] & levels);
+
+	if (light == cfg->zapper_light && trigger == cfg->zapper_trigger) {
+		return;
+	}
+	cfg->zapper_light = light;
+	cfg->zapper_trigger = trigger;
+
+	pads_timestamp(dev, ns);
+	input_report_key(dev, BTN_TRIGGER, trigger);
+	input_report_abs(dev, ABS_MISC, light);
+	input_sync(dev);
+}
+
+/**
+ * Report the buttons and the d-pad of a pad.
+ *
+ * @param cfg The pad configuration
+ * @param i Index of the pad
+ * @param g The data pin of the pad
+ * @param data The read data, from the first bit of the pad
+ * @param n_keys Number of buttons, 4 for the NES pads of a Four Score and 8 for all others
+ */
+static void pad_report(struct pads_config *cfg, unsigned char i, unsigned int g, const u32 *data, int n_keys) {
+	struct input_dev *dev = cfg->pad[i];
+	int j;
+
+	pads_timestamp(dev, cfg->latch);
+	for (j = 0; j < n_keys; j++) {
+		input_report_key(dev, btn_label[j], g & data[btn_index[j]]);
+	}
+	input_report_abs(dev, ABS_X, !(g & data[6]) - !(g & data[7]));
+	input_report_abs(dev, ABS_Y, !(g & data[4]) - !(g & data[5]));
+	input_sync(dev);
+}
+
+/**
+ * Clear the buttons and axises of a pad.
+ *
+ * @param cfg The pad configuration
+ * @param i Index of the pad
+ */
+static void pad_release(struct pads_config *cfg, unsigned char i) {
+	struct input_dev *dev = cfg->pad[i];
+	int j;
+
+	if (!dev) {
+		return;
+	}
+	pads_timestamp(dev, cfg->latch);
+	for (j = 0; j < 8; j++) {
+		input_report_key(dev, btn_label[j], 0);
+	}
+	input_report_abs(dev, ABS_X, 0);
+	input_report_abs(dev, ABS_Y, 0);
+	input_sync(dev);
+}
+
+/**
+ * Report the four pads of a NES Four Score. The pads on the second plug of a port are shifted out after the first.
+ *
+ * @param cfg The pad configuration
+ * @param first Index of the first pad of the Four Score
+ * @param g1 Data pin of the first port of the Four Score
+ * @param g2 Data pin of the second port of the Four Score
+ * @param data The read data
+ */
+static void fourscore_report(struct pads_config *cfg, unsigned char first, unsigned int g1, unsigned int g2, const u32 *data) {
+	pad_report(cfg, first, g1, data, 4);
+	pad_report(cfg, first + 1, g2, data, 4);
+	pad_report(cfg, first + 2, g1, data + 8, 4);
+	pad_report(cfg, first + 3, g2, data + 8, 4);
+}
+
+/**
+ * Set the number of players. The buttons and axises of the pads that are no longer in use are cleared.
+ * 
+ * @param cfg The pad configuration
+ * @param n Number of players
+ */
+static void pads_players(struct pads_config *cfg, unsigned char n) {
+	int i;
+
+	for (i = n; i < cfg->player_mode; i++) {
+		pad_release(cfg, i);
+	}
+	cfg->player_mode = n;
+}
+
+/**
+ * Detect the SNES Multitaps outside of the reads, for backends that can not change the direction of D0 from the
+ * timers. The reads use the result until the next detection. Must be called while the bus is idle.
+ *
+ * @param cfg The pad configuration
+ */
+void pads_detect(struct pads_config *cfg) {
+	cfg->taps = cfg->multitap_enabled ? multitap_connected(cfg) : 0;
+}
+
+/**
+ * Read the bus, using the transaction that matches the connected adapter.
+ *
+ * @param cfg The pad configuration
+ * @param cap Capture to store the read data in
+ */
+void pads_acquire(struct pads_config *cfg, struct pads_capture *cap) {
+	unsigned int taps = 0;
+
+	if (cfg->multitap_enabled) {
+		taps = gpio_atomic_direction ? multitap_connected(cfg) : cfg->taps;
+	}
+
+	// A second Multitap on port 1 is only read while the one on port 2 is connected.
+	if (taps & cfg->gpio[3]) {
+		pads_read_multitap(cfg, cap, taps & cfg->gpio[2]);
+	} else {
+		pads_read(cfg, cap);
+	}
+}
+
+/**
+ * Choose the read of a bus transaction of the low-CPU engine, the same way as pads_acquire.
+ *
+ * @param cfg The pad configuration
+ * @param bus The transaction
+ * @param taps The D0 pins of the ports with a SNES Multitap
+ */
+static void pads_bus_choose(struct pads_config *cfg, struct pads_bus *bus, unsigned int taps) {
+	struct pads_capture *cap = bus->cap;
+
+	if (taps & cfg->gpio[3]) {
+		bus->pp = cfg->gpio[5];
+		cap->type = PADS_CAPTURE_MULTITAP;
+		if (taps & cfg->gpio[2]) {
+			bus->pp |= cfg->gpio[7];
+			cap->type = PADS_CAPTURE_MULTITAP_DUAL;
+		}
+		bus->bits = BITS_LENGTH_MULTITAP;
+	} else {
+		bus->pp = 0;
+		cap->type = cfg->mouse_ports ? PADS_CAPTURE_MOUSE : PADS_CAPTURE_STANDARD;
+		bus->bits = pads_bits(cfg);
+	}
+	bus->phase = PADS_BUS_LATCH;
+	bus->edge = 0;
+}
+
+/**
+ * Start a bus transaction of the low-CPU engine. Nothing is done on the bus until the first step.
+ *
+ * @param cfg The pad configuration
+ * @param bus The transaction
+ * @param cap Capture to store the read data in
+ */
+void pads_bus_start(struct pads_config *cfg, struct pads_bus *bus, struct pads_capture *cap) {
+	bus->cap = cap;
+	if (!cfg->multitap_enabled || !gpio_atomic_direction) {
+		pads_bus_choose(cfg, bus, cfg->multitap_enabled ? cfg->taps : 0);
+		return;
+	}
+	multitap_pins(cfg, &bus->d0, &bus->d1);
+	bus->high = bus->d1;
+	bus->low = 0;
+	bus->pp = 0;
+	bus->edge = 0;
+	bus->phase = PADS_BUS_DETECT;
+}
+
+/**
+ * Do the next step of a bus transaction of the low-CPU engine. A step is what is due at one point in time, a clock
+ * edge and the reads and writes that go with it. The edges come in the same order and at least as far apart as the
+ * ones of pads_acquire.
+ *
+ * @param cfg The pad configuration
+ * @param bus The transaction
+ * @return Time in us until the next step is due, or 0 if the capture is complete
+ */
+unsigned int pads_bus_step(struct pads_config *cfg, struct pads_bus *bus) {
+	unsigned int clk = cfg->gpio[0], latch = cfg->gpio[1];
+	u32 *data = bus->cap->data;
+	int i;
+
+	switch (bus->phase) {
+	case PADS_BUS_DETECT:
+		gpio_output(bus->d0);
+		gpio_set(bus->d0);
+		gpio_set(clk);
+		bus->phase = PADS_BUS_DETECT_CLOCK;
+		return DELAY * 2;
+
+	case PADS_BUS_DETECT_CLOCK:
+		// Eight clock cycles with D0 high, then eight with D0 low
+		if (!(bus->edge++ & 1)) {
+			gpio_clear(clk);
+			if (bus->edge < 16) {
+				bus->high &= ~gpio_read_all();
+			} else {
+				bus->low |= bus->d1 & gpio_read_all();
+			}
+			return DELAY;
+		}
+		gpio_set(clk);
+		if (bus->edge == 16) {
+			gpio_clear(bus->d0);
+		}
+		if (bus->edge < 32) {
+			return DELAY;
+		}
+		gpio_input(bus->d0);
+
+		// The read follows right away
+		pads_bus_choose(cfg, bus, multitap_ports(cfg, bus->high, bus->low));
+		return pads_bus_step(cfg, bus);
+
+	case PADS_BUS_LATCH:
+		if (bus->edge == 0) {
+			gpio_set(clk | latch);
+			bus->cap->latch = ktime_to_ns(ktime_get());
+			bus->edge = cfg->mouse_cycle && !bus->pp ? 1 : 3;
+			return DELAY * 2;
+		}
+
+		// A clock pulse while latched cycles the sensitivity of SNES mice.
+		if (bus->edge == 1) {
+			gpio_clear(clk);
+			bus->edge = 2;
+			return DELAY;
+		}
+		if (bus->edge == 2) {
+			gpio_set(clk);
+			cfg->mouse_cycle = false;
+			bus->edge = 3;
+			return DELAY;
+		}
+		gpio_clear(latch);
+		bus->phase = PADS_BUS_READ;
+		bus->edge = 0;
+		return DELAY;
+
+	case PADS_BUS_READ:
+		i = bus->edge++ / 2;
+		if (bus->edge & 1) {
+			gpio_clear(clk);
+			data[i] = gpio_read_all();
+			return DELAY;
+		}
+		gpio_set(clk);
+
+		// The Multitap switches to its other pads halfway through the read
+		if (bus->pp && i + 1 == bus->bits / 2) {
+			gpio_clear(bus->pp);
+		}
+		if (i + 1 < bus->bits) {
+			return DELAY;
+		}
+		if (bus->pp) {
+			gpio_set(bus->pp);
+		}
+		for (i = bus->bits; i < BUFFER_SIZE; i++) {
+			data[i] = 0;
+		}
+		bus->phase = PADS_BUS_IDLE;
+		return 0;
+	}
+	return 0;
+}
+
+/**
+ * Abort a bus transaction of the low-CPU engine and leave the bus idle, clock high and latch low.
+ *
+ * @param cfg The pad configuration
+ * @param bus The transaction
+ */
+void pads_bus_abort(struct pads_config *cfg, struct pads_bus *bus) {
+	if (bus->phase == PADS_BUS_IDLE) {
+		return;
+	}
+	if (bus->phase == PADS_BUS_DETECT_CLOCK) {
+		gpio_input(bus->d0);
+	}
+	gpio_set(cfg->gpio[0] | bus->pp);
+	gpio_clear(cfg->gpio[1]);
+	bus->phase = PADS_BUS_IDLE;
+}
+
+/**
+ * Update the status of all connected devices from a capture.
+ *
+ * @param cfg The pad configuration
+ * @param cap The capture to decode
+ */
+void pads_update(struct pads_config *cfg, const struct pads_capture *cap) {
+	const u32 *data = cap->data;
+	unsigned int g, mice;
+	unsigned char i;
+
+	cfg->latch = cap->latch;
+
+	mice = cfg->mouse_ports;
+	mouse_track(cfg, cap);
+	for (i = 0; i < NUMBER_OF_MICE; i++) {
+		g = cfg->gpio[i + 2];
+		if (cfg->mouse_ports & g) {
+			if (!(mice & g)) {
+				// Mouse connected, release the buttons the pad of the port held.
+				pad_release(cfg, i);
+			}
+			mouse_report(cfg, i, data);
+		} else if (mice & g) {
+			// Mouse disconnected, release its buttons.
+			input_report_key(cfg->mouse[i], BTN_RIGHT, 0);
+			input_report_key(cfg->mouse[i], BTN_LEFT, 0);
+			input_sync(cfg->mouse[i]);
+		}
+	}
+
+	if (cap->type == PADS_CAPTURE_MULTITAP || cap->type == PADS_CAPTURE_MULTITAP_DUAL) {
+		// SNES Multitap on port 2, player 2 - 5. Player 1 is the pad on port 1, or the first pad of a second Multitap.
+		pad_report(cfg, 0, cfg->gpio[2], data, 8);
+		pad_report(cfg, 1, cfg->gpio[3], data, 8);
+		pad_report(cfg, 2, cfg->gpio[4], data, 8);
+
+		// Player 4 and 5 are shifted out after PP went low
+		pad_report(cfg, 3, cfg->gpio[3], data + BITS_LENGTH_MULTITAP / 2, 8);
+		pad_report(cfg, 4, cfg->gpio[4], data + BITS_LENGTH_MULTITAP / 2, 8);
+
+		if (cap->type == PADS_CAPTURE_MULTITAP_DUAL && multitap_dual(cfg)) {
+			// Second SNES Multitap on port 1, player 6 - 8
+			pad_report(cfg, 5, cfg->gpio[6], data, 8);
+			pad_report(cfg, 6, cfg->gpio[2], data + BITS_LENGTH_MULTITAP / 2, 8);
+			pad_report(cfg, 7, cfg->gpio[6], data + BITS_LENGTH_MULTITAP / 2, 8);
+			pads_players(cfg, 8);
+		} else {
+			pads_players(cfg, 5);
+		}
+	} else {
+		if (cfg->fourscore_enabled && fourscore_connected(cfg->gpio[2], cfg->gpio[3], data)) {
+			// NES Four Score, player 1 - 4
+			fourscore_report(cfg, 0, cfg->gpio[2], cfg->gpio[3], data);
+
+			if (fourscore_dual(cfg) && fourscore_connected(cfg->gpio[6], cfg->gpio[7], data)) {
+				// Second NES Four Score on port 3 and 4, player 5 - 8
+				fourscore_report(cfg, 4, cfg->gpio[6], cfg->gpio[7], data);
+				pads_players(cfg, 8);
+			} else {
+				pads_players(cfg, 4);
+			}
+		} else {
+			// NES or SNES gamepad
+	
+			// Player 1 and 2
+			for (i = 0; i < 2; i++) {
+				g = cfg->gpio[i + 2];
+
+				// Ports with a SNES Mouse are reported by the mouse devices.
+				if (cfg->mouse_ports & g) {
+					continue;
+				}
+				pad_report(cfg, i, g, data, 8);
+			}
+	
+			// Clear virtual devices 3 and up
+			pads_players(cfg, 2);
+		}
+
+		if (cfg->paddle_enabled) {
+			paddle_report(cfg, data);
+		}
+
+		if (cfg->zapper_enabled && !cfg->zapper_sampling) {
+			zapper_report(cfg, data[0], cap->latch);
+		}
+	}
+}
+
+/**
+ * Setup all GPIOs. The pull-ups of all data pins are enabled with one sequence.
+ * 
+ * @param cfg Pads config
+ */
+void pads_setup_gpio(struct pads_config *cfg) {
+	unsigned int data = 0, pp = cfg->gpio[5];
+	int i;
+
+	// port1_pp of a second Multitap is on port2_d4
+	if (multitap_dual(cfg)) {
+		pp |= cfg->gpio[7];
+	}
+
+	// Setup GPIO for clk, latch and the pp lines at the levels of the idle bus, clock and pp high and latch low. The
+	// levels are set first, both backends drive them from the first edge on.
+	gpio_clear(cfg->gpio[1]);
+	gpio_set(cfg->gpio[0] | pp);
+	gpio_output(cfg->gpio[0] | cfg->gpio[1] | pp);
+
+	// Setup GPIO for port1_d0, port2_d0, port2_d1 and the optional port2_d3 and port2_d4
+	for (i = 2; i < 5; i++) {
+		data |= cfg->gpio[i];
+	}
+	for (i = NUMBER_OF_GPIOS; i < cfg->n_gpios; i++) {
+		data |= cfg->gpio[i];
+	}
+	data &= ~pp;
+	gpio_input(data);
+	gpio_enable_pull_up(data);
+}
+
+/**
+ * Release the GPIOs. The outputs are set back to inputs, so pins that are no longer used do not drive anything.
+ *
+ * @param cfg Pads config
+ */
+void pads_release_gpio(struct pads_config *cfg) {
+	gpio_input(cfg->gpio[0] | cfg->gpio[1] | cfg->gpio[5] | (multitap_dual(cfg) ? cfg->gpio[7] : 0));
+}
+
+/**
+ * Show function for the sysfs attribute latch_ns of the input devices.
+ * Time in ns (CLOCK_MONOTONIC) when the bus was latched for the last reported events. Subtract it from the
+ * current time to get the age of the input.
+ */
+static ssize_t latch_ns_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct pads_config *cfg = input_get_drvdata(to_input_dev(dev));
+
+	return sprintf(buf, "%lld\n", cfg->latch);
+}
+
+static DEVICE_ATTR_RO(latch_ns);
+
+static struct attribute *pads_attrs[] = {
+	&dev_attr_latch_ns.attr,
+	NULL,
+};
+
+ATTRIBUTE_GROUPS(pads);
+
+/**
+ * Get a device slot of the configuration. Slots are numbered pads, mice, paddle, Zapper.
+ *
+ * @param cfg Pads configuration
+ * @param slot Index of the slot
+ * @return The slot
+ */
+static struct input_dev **pads_slot(struct pads_config *cfg, int slot) {
+	if (slot < NUMBER_OF_INPUT_DEVICES) {
+		return &cfg->pad[slot];
+	}
+	slot -= NUMBER_OF_INPUT_DEVICES;
+	if (slot < NUMBER_OF_MICE) {
+		return &cfg->mouse[slot];
+	}
+	return (slot == NUMBER_OF_MICE) ? &cfg->paddle : &cfg->zapper;
+}
+
+/**
+ * Allocate and set up an input device.
+ *
+ * @param cfg Pads configuration
+ * @param slot Slot of the device, see pads_slot
+ * @param name Name of the device
+ * @param phys Prefix of the device path name
+ * @param i Index of the device
+ * @param product Product id of the device
+ * @return The input device, or NULL if there was not enough memory
+ */
+static struct input_dev *pads_allocate(struct pads_config *cfg, int slot, char *name, const char *phys, int i, int product) {
+	struct input_dev *dev;
+
+	dev = input_allocate_device();
+	if (!dev) {
+		pr_err("Not enough memory for input device!\n");
+		return NULL;
+	}
+
+	// Create the device path name in userspace.
+	snprintf(cfg->phys[slot], sizeof(cfg->phys[slot]), "%s%d", phys, i);
+	dev->phys = cfg->phys[slot];
+
+	dev->name = name;
+	dev->id.bustype = BUS_PARPORT;
+	dev->id.vendor = 0x0001;
+	dev->id.product = product;
+	dev->id.version = 0x0100;
+
+	input_set_drvdata(dev, cfg);
+
+	dev->open = cfg->open;
+	dev->close = cfg->close;
+	dev->dev.groups = pads_groups;
+
+	*pads_slot(cfg, slot) = dev;
+	return dev;
+}
+
+/**
+ * Free the input devices that are not registered.
+ *
+ * @param cfg Pads configuration
+ */
+static void pads_free(struct pads_config *cfg) {
+	struct input_dev **dev;
+	int slot;
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		dev = pads_slot(cfg, slot);
+		if (*dev) {
+			input_free_device(*dev);
+			*dev = NULL;
+		}
+	}
+}
+
+/**
+ * Check if the device of a slot is used by the configuration. The first five pads are always used, the others when
+ * a second adapter can be connected.
+ *
+ * @param cfg Pads configuration
+ * @param slot Index of the slot
+ * @return true if the slot should have a device
+ */
+static bool pads_wanted(const struct pads_config *cfg, int slot) {
+	if (slot < NUMBER_OF_SINGLE_PADS) {
+		return true;
+	}
+	if (slot < NUMBER_OF_INPUT_DEVICES) {
+		return multitap_dual(cfg) || fourscore_dual(cfg);
+	}
+	if (slot < PADS_SLOT_PADDLE) {
+		return cfg->mouse_enabled;
+	}
+	return (slot == PADS_SLOT_PADDLE) ? cfg->paddle_enabled : cfg->zapper_enabled;
+}
+
+/**
+ * Allocate and set up the input device of a slot.
+ *
+ * @param cfg Pads configuration
+ * @param slot Index of the slot
+ * @return The input device, or NULL if there was not enough memory
+ */
+static struct input_dev *pads_create(struct pads_config *cfg, int slot) {
+	struct input_dev *dev;
+	int j;
+
+	if (slot < NUMBER_OF_INPUT_DEVICES) {
+		dev = pads_allocate(cfg, slot, cfg->device_name, "input", slot, 1);
+		if (!dev) {
+			return NULL;
+		}
+
+		dev->evbit[0] = BIT_MASK(EV_KEY) | BIT_MASK(EV_ABS);
+		for (j = 0; j < 2; j++) {
+			input_set_abs_params(dev, ABS_X + j, -1, 1, 0, 0);
+		}
+		for (j = 0; j < 8; j++) {
+			__set_bit(btn_label[j], dev->keybit);
+		}
+	} else if (slot < PADS_SLOT_PADDLE) {
+		// SNES mice on port 1 and 2.
+		dev = pads_allocate(cfg, slot, "SNES Mouse", "mouse", slot - NUMBER_OF_INPUT_DEVICES, 2);
+		if (!dev) {
+			return NULL;
+		}
+
+		input_set_capability(dev, EV_KEY, BTN_LEFT);
+		input_set_capability(dev, EV_KEY, BTN_RIGHT);
+		input_set_capability(dev, EV_REL, REL_X);
+		input_set_capability(dev, EV_REL, REL_Y);
+		__set_bit(INPUT_PROP_POINTER, dev->propbit);
+	} else if (slot == PADS_SLOT_PADDLE) {
+		// Arkanoid Vaus paddle on port 2.
+		dev = pads_allocate(cfg, slot, "Arkanoid Paddle", "paddle", 0, 3);
+		if (!dev) {
+			return NULL;
+		}
+		input_set_abs_params(dev, ABS_X, 0, (1 << PADDLE_BITS) - 1, 0, 0);
+		input_set_capability(dev, EV_KEY, BTN_A);
+	} else {
+		// NES Zapper on port 2.
+		dev = pads_allocate(cfg, slot, "NES Zapper", "zapper", 0, 4);
+		if (!dev) {
+			return NULL;
+		}
+		input_set_capability(dev, EV_KEY, BTN_TRIGGER);
+		input_set_abs_params(dev, ABS_MISC, 0, 1, 0, 0);
+	}
+
+	return dev;
+}
+
+/**
+ * Allocate the input devices and setup the GPIOs. The devices are registered with pads_register, once the bus is live.
+ * 
+ * @param cfg Pads configuration
+ * @return Status
+ */
+int __init pads_setup(struct pads_config *cfg) {
+	int slot;
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		if (pads_wanted(cfg, slot) && !pads_create(cfg, slot)) {
+			pads_free(cfg);
+			return -ENOMEM;
+		}
+	}
+
+	// Done with the input event handlers. 
+	// Setup the GPIO pins
+	pads_setup_gpio(cfg);
+	return 0;
+}
+
+/**
+ * Register all input devices. If one of them can not be registered, all devices are unregistered and freed.
+ *
+ * @param cfg Pads configuration
+ * @return Status
+ */
+int pads_register(struct pads_config *cfg) {
+	struct input_dev **dev;
+	int slot, failed, status = 0;
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		dev = pads_slot(cfg, slot);
+		if (*dev) {
+			status = input_register_device(*dev);
+			if (status != 0) {
+				pr_err("Could not register %s.\n", (*dev)->name);
+				break;
+			}
+		}
+	}
+
+	if (status != 0) {
+		failed = slot;
+		for (slot = 0; slot < failed; slot++) {
+			dev = pads_slot(cfg, slot);
+			if (*dev) {
+				input_unregister_device(*dev);
+				*dev = NULL;
+			}
+		}
+		pads_free(cfg);
+		return status;
+	}
+
+	cfg->registered = true;
+	return 0;
+}
+
+/**
+ * Create and register the devices that the configuration uses but that do not exist yet. The devices that already
+ * exist are kept. If one of the new devices can not be registered, all new devices are unregistered and freed.
+ *
+ * @param cfg Pads configuration
+ * @return Status
+ */
+int pads_add(struct pads_config *cfg) {
+	struct input_dev **dev;
+	unsigned int added = 0;
+	int slot, status = 0;
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		dev = pads_slot(cfg, slot);
+		if (*dev || !pads_wanted(cfg, slot)) {
+			continue;
+		}
+
+		if (!pads_create(cfg, slot)) {
+			status = -ENOMEM;
+			break;
+		}
+
+		status = input_register_device(*dev);
+		if (status != 0) {
+			pr_err("Could not register %s.\n", (*dev)->name);
+			input_free_device(*dev);
+			*dev = NULL;
+			break;
+		}
+		added |= 1 << slot;
+	}
+
+	if (status != 0) {
+		for (slot = 0; slot < PADS_SLOTS; slot++) {
+			if (added & (1 << slot)) {
+				dev = pads_slot(cfg, slot);
+				input_unregister_device(*dev);
+				*dev = NULL;
+			}
+		}
+	}
+	return status;
+}
+
+/**
+ * Unregister the devices that the configuration no longer uses.
+ *
+ * @param cfg Pads configuration
+ */
+void pads_prune(struct pads_config *cfg) {
+	struct input_dev **dev;
+	int slot;
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		dev = pads_slot(cfg, slot);
+		if (*dev && !pads_wanted(cfg, slot)) {
+			input_unregister_device(*dev);
+			*dev = NULL;
+		}
+	}
+}
+
+/**
+ * Unregister or free all input devices.
+ *
+ * @param cfg Pads configuration
+ */
+void pads_remove(struct pads_config *cfg) {
+	struct input_dev **dev;
+	int slot;
+
+	if (!cfg->registered) {
+		pads_free(cfg);
+		return;
+	}
+
+	for (slot = 0; slot < PADS_SLOTS; slot++) {
+		dev = pads_slot(cfg, slot);
+		if (*dev) {
+			input_unregister_device(*dev);
+			*dev = NULL;
+		}
+	}
+	cfg->registered = false;
+}
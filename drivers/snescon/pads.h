@@ -0,0 +1,135 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+#ifndef SNESCON_PADS_H_
+#define SNESCON_PADS_H_
+
+#include <linux/types.h>
+#include <linux/input.h>
+
+#define DELAY 6
+#define BUFFER_SIZE 34
+#define BITS_LENGTH_MULTITAP 34
+#define BITS_LENGTH 24
+#define BITS_LENGTH_MOUSE 32
+#define BITS_LENGTH_PADDLE 16	// A SNES pad on port 1 and the 8 bit paddle position on port 2
+#define PADDLE_BITS 8
+#define NUMBER_OF_GPIOS 6
+#define MAX_NUMBER_OF_GPIOS 8
+#define NUMBER_OF_INPUT_DEVICES 8
+#define NUMBER_OF_SINGLE_PADS 5	// Players with one adapter, pad 6 - 8 are only created for a second adapter
+#define NUMBER_OF_MICE 2
+#define MOUSE_SPEEDS 3
+#define PADS_SLOT_PADDLE (NUMBER_OF_INPUT_DEVICES + NUMBER_OF_MICE)
+#define PADS_SLOT_ZAPPER (PADS_SLOT_PADDLE + 1)
+#define PADS_SLOTS (PADS_SLOT_ZAPPER + 1)	// Input devices: pads, mice, paddle and Zapper.
+
+/*
+ * Structure that contain the configuration.
+ *
+ * Structuring of the gpio and gamepad arrays:
+ * gpio: <clk, latch, port1_d0 (data1), port2_d0 (data2), port2_d1 (data4), port2_pp (data6), [port2_d3, port2_d4]>
+ * pad: <pad 1, pad 2, pad 3, pad 4, pad 5, [pad 6, pad 7, pad 8]>
+ * mouse: <port 1, port 2>
+ *
+ * port2_d3 and port2_d4 connect a second adapter to the same clk and latch. With the Multitap enabled they are
+ * port1_d1 and port1_pp of a second Multitap on port 1, otherwise with the Four Score enabled they are port3_d0 and
+ * port4_d0 of a second Four Score. The second adapter is only read while the first one is connected.
+ *
+ * The GPIOs and the enabled devices can be changed while the driver is running, with polling paused. Devices are
+ * then added with pads_add and removed with pads_prune.
+ *
+ */
+struct pads_config {
+	unsigned int gpio[MAX_NUMBER_OF_GPIOS];
+	unsigned char n_gpios;	// Number of configured GPIOs, port2_d3 and port2_d4 are optional.
+	struct input_dev *pad[NUMBER_OF_INPUT_DEVICES];
+	unsigned char player_mode;
+	char *device_name;
+	int (* open) (struct input_dev *dev);
+	void (* close) (struct input_dev *dev);
+	bool multitap_enabled;
+	unsigned int taps;	// D0 pins of the ports with a SNES Multitap, set by pads_detect, see gpio_atomic_direction.
+	bool fourscore_enabled;
+	s64 latch;	// Time in ns (CLOCK_MONOTONIC) when the latch of the last reported capture was asserted.
+	struct input_dev *mouse[NUMBER_OF_MICE];
+	bool mouse_enabled;
+	unsigned int mouse_speed;	// Requested sensitivity of SNES mice, 0 = slow, 1 = normal, 2 = fast.
+	unsigned int mouse_ports;	// Data pins of the ports where a SNES Mouse is connected.
+	bool mouse_cycle;	// Cycle the sensitivity of the mice on the next read.
+	int mouse_dx[NUMBER_OF_MICE];	// Motion accumulated since the mouse was last reported.
+	int mouse_dy[NUMBER_OF_MICE];
+	struct input_dev *paddle;	// Arkanoid Vaus paddle on port 2.
+	bool paddle_enabled;
+	struct input_dev *zapper;	// NES Zapper on port 2.
+	bool zapper_enabled;
+	bool zapper_trigger;	// Last reported state of the Zapper.
+	bool zapper_light;
+	bool zapper_sampling;	// Set while the Zapper is sampled and reported at high rate, outside of pads_update.
+	char phys[PADS_SLOTS][16];	// Device path names of the input devices.
+	bool registered;	// Set when the input devices are registered.
+};
+
+// Bus transaction used to acquire a capture
+#define PADS_CAPTURE_STANDARD 0
+#define PADS_CAPTURE_MULTITAP 1
+#define PADS_CAPTURE_MOUSE 2	// Standard read extended to the 32 bits of the SNES Mouse report
+#define PADS_CAPTURE_MULTITAP_DUAL 3	// Multitap read with a second Multitap on port 1, both PP lines switched together
+
+/*
+ * One raw read of the bus.
+ *
+ * data holds the negated GPIO level register sampled at every clock pulse, latch the time when the latch was asserted.
+ * The layout is also the record format of the debugfs captures file, so it must not change between driver versions.
+ */
+struct pads_capture {
+	s64 latch;
+	u32 type;
+	u32 data[BUFFER_SIZE];
+};
+
+// Phases of a bus transaction of the low-CPU engine
+#define PADS_BUS_IDLE 0
+#define PADS_BUS_DETECT 1	// Multitap detection, D0 driven
+#define PADS_BUS_DETECT_CLOCK 2	// Multitap detection, clocking
+#define PADS_BUS_LATCH 3
+#define PADS_BUS_READ 4
+
+/*
+ * A bus transaction of the low-CPU engine. pads_bus_step does what is due on one clock edge and returns the time until
+ * the next one, so the caller can wait for it with a timer instead of busy-waiting. The transactions are the same as
+ * the ones of pads_acquire.
+ */
+struct pads_bus {
+	struct pads_capture *cap;
+	unsigned char phase;
+	unsigned char edge;	// Position in the phase, the clock edges done while clocking, falling and rising.
+	unsigned char bits;	// Bits to read.
+	unsigned int d0;	// Multitap detection, the D0 pins driven and the D1 pins read.
+	unsigned int d1;
+	unsigned int high;	// D1 pins that followed D0 high, and the ones that followed it low.
+	unsigned int low;
+	unsigned int pp;	// PP pins switched halfway through a Multitap read, 0 for other reads.
+};
+
+void pads_detect(struct pads_config *cfg);
+void pads_acquire(struct pads_config *cfg, struct pads_capture *cap);
+void pads_bus_start(struct pads_config *cfg, struct pads_bus *bus, struct pads_capture *cap);
+unsigned int pads_bus_step(struct pads_config *cfg, struct pads_bus *bus);
+void pads_bus_abort(struct pads_config *cfg, struct pads_bus *bus);
+void pads_update(struct pads_config *cfg, const struct pads_capture *cap);
+void mouse_track(struct pads_config *cfg, const struct pads_capture *cap);
+void zapper_report(struct pads_config *cfg, u32 levels, s64 ns);
+int __init pads_setup(struct pads_config *cfg);
+int pads_register(struct pads_config *cfg);
+int pads_add(struct pads_config *cfg);
+void pads_prune(struct pads_config *cfg);
+void pads_setup_gpio(struct pads_config *cfg);
+void pads_release_gpio(struct pads_config *cfg);
+void pads_remove(struct pads_config *cfg);
+
+#endif /* SNESCON_PADS_H_ */
@@ -0,0 +1,599 @@
+/*
+ * KUnit tests for the NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Tests the decoding and the adapter detection of pads.c against a fake bus. pads.c is included, so its static
+ * functions can be tested, and the GPIO backend is replaced by the fake bus below. Built as snescon_kunit.ko when
+ * the kernel has CONFIG_KUNIT, the results are in the kernel log once the module is loaded. make -C host test runs
+ * the suite on the host, against the host input core.
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include "pads.c"
+
+#define TIMING_ROUNDS 10000	// Decodes of every kind of capture timed by pads_test_timing
+
+static const unsigned int gpio_id[] = { 2, 3, 4, 7, 10, 11, 17, 27 };	// Default GPIOs, port2_d3 and port2_d4
+
+/*
+ * Fake bus. Inputs are pulled up, outputs read back as driven. D1 of a port with a SNES Multitap follows its D0
+ * while D0 is driven.
+ */
+static struct {
+	const struct pads_config *cfg;
+	u32 out;	// Levels of the outputs
+	u32 dir;	// Outputs
+	unsigned int taps;	// D0 pins of the ports with a SNES Multitap, port2_d0 and port1_d0
+} bus;
+
+/**
+ * Get the levels of the fake bus.
+ *
+ * @return The GPIO level register
+ */
+static u32 bus_levels(void) {
+	const unsigned int *gpio = bus.cfg->gpio;
+	u32 levels = ~bus.dir | (bus.dir & bus.out);
+
+	if ((bus.taps & gpio[3]) && (bus.dir & gpio[3])) {
+		levels = (levels & ~gpio[4]) | ((levels & gpio[3]) ? gpio[4] : 0);
+	}
+	if ((bus.taps & gpio[2]) && (bus.dir & gpio[2]) && gpio[6]) {
+		levels = (levels & ~gpio[6]) | ((levels & gpio[2]) ? gpio[6] : 0);
+	}
+	return levels;
+}
+
+const bool gpio_atomic_direction = true;
+
+void gpio_set(unsigned int g_bit) {
+	bus.out |= g_bit;
+}
+
+void gpio_clear(unsigned int g_bit) {
+	bus.out &= ~g_bit;
+}
+
+void gpio_input(unsigned int g_bit) {
+	bus.dir &= ~g_bit;
+}
+
+void gpio_output(unsigned int g_bit) {
+	bus.dir |= g_bit;
+}
+
+void gpio_enable_pull_up(unsigned int g_bit) {
+}
+
+unsigned int gpio_read_all(void) {
+	return ~bus_levels();
+}
+
+/**
+ * Set up a configuration with all 8 GPIOs and register all devices. The tests enable the adapters they need.
+ *
+ * @param test The test
+ * @return Status
+ */
+static int pads_test_init(struct kunit *test) {
+	struct pads_config *cfg;
+	int i;
+
+	cfg = kunit_kzalloc(test, sizeof(*cfg), GFP_KERNEL);
+	if (!cfg) {
+		return -ENOMEM;
+	}
+
+	cfg->device_name = "SNES pad";
+	cfg->n_gpios = MAX_NUMBER_OF_GPIOS;
+	for (i = 0; i < MAX_NUMBER_OF_GPIOS; i++) {
+		cfg->gpio[i] = 1 << gpio_id[i];
+	}
+	for (i = 0; i < PADS_SLOTS; i++) {
+		if (!pads_create(cfg, i)) {
+			pads_free(cfg);
+			return -ENOMEM;
+		}
+	}
+	if (pads_register(cfg) != 0) {
+		return -ENODEV;
+	}
+
+	memset(&bus, 0, sizeof(bus));
+	bus.cfg = cfg;
+	test->priv = cfg;
+	return 0;
+}
+
+static void pads_test_exit(struct kunit *test) {
+	// Also called when the init failed
+	if (test->priv) {
+		pads_remove(test->priv);
+	}
+}
+
+/**
+ * Get a capture with no buttons pressed.
+ *
+ * @param test The test
+ * @param type Type of the capture
+ * @return The capture
+ */
+static struct pads_capture *pads_test_capture(struct kunit *test, u32 type) {
+	struct pads_capture *cap = kunit_kzalloc(test, sizeof(*cap), GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(test, cap);
+	cap->type = type;
+	return cap;
+}
+
+/**
+ * Add the signature of a NES Four Score to a capture.
+ *
+ * @param cap The capture
+ * @param g1 Data pin of the first port of the Four Score
+ * @param g2 Data pin of the second port of the Four Score
+ */
+static void fourscore_sign(struct pads_capture *cap, unsigned int g1, unsigned int g2) {
+	cap->data[19] |= g1;
+	cap->data[18] |= g2;
+}
+
+/**
+ * Check that a pad has exactly one of the buttons pressed, and the d-pad centered.
+ *
+ * @param test The test
+ * @param dev The pad
+ * @param btn The pressed button, or 0 for none
+ */
+static void pads_expect(struct kunit *test, struct input_dev *dev, unsigned int btn) {
+	int j;
+
+	for (j = 0; j < ARRAY_SIZE(btn_label); j++) {
+		KUNIT_EXPECT_EQ_MSG(test, test_bit(btn_label[j], dev->key), btn_label[j] == btn,
+				    "%s button %ld", dev->phys, btn_label[j]);
+	}
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(dev, ABS_X), 0);
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(dev, ABS_Y), 0);
+}
+
+static void pads_test_standard(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cap->data[8] |= cfg->gpio[2];	// A on port 1
+	cap->data[4] |= cfg->gpio[3];	// Up on port 2
+	cap->data[7] |= cfg->gpio[3];	// Right on port 2
+	pads_update(cfg, cap);
+
+	pads_expect(test, cfg->pad[0], BTN_A);
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_B, cfg->pad[1]->key));
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->pad[1], ABS_X), 1);
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->pad[1], ABS_Y), -1);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 2);
+}
+
+static void pads_test_multitap(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_MULTITAP);
+	int half = BITS_LENGTH_MULTITAP / 2;
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cfg->multitap_enabled = true;
+	cap->data[0] |= cfg->gpio[2];	// B, pad on port 1
+	cap->data[1] |= cfg->gpio[3];	// Y, Multitap port 2
+	cap->data[2] |= cfg->gpio[4];	// Select, Multitap port 3
+	cap->data[3 + half] |= cfg->gpio[3];	// Start, Multitap port 4, after PP went low
+	cap->data[8 + half] |= cfg->gpio[4];	// A, Multitap port 5
+	pads_update(cfg, cap);
+
+	pads_expect(test, cfg->pad[0], BTN_B);
+	pads_expect(test, cfg->pad[1], BTN_Y);
+	pads_expect(test, cfg->pad[2], BTN_SELECT);
+	pads_expect(test, cfg->pad[3], BTN_START);
+	pads_expect(test, cfg->pad[4], BTN_A);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 5);
+}
+
+static void pads_test_multitap_dual(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_MULTITAP_DUAL);
+	int half = BITS_LENGTH_MULTITAP / 2;
+
+	cfg->multitap_enabled = true;
+	cap->data[0] |= cfg->gpio[2];	// B, player 1 on the first port of the Multitap on port 1
+	cap->data[9] |= cfg->gpio[6];	// X, player 6
+	cap->data[10 + half] |= cfg->gpio[2];	// L, player 7
+	cap->data[11 + half] |= cfg->gpio[6];	// R, player 8
+	pads_update(cfg, cap);
+
+	pads_expect(test, cfg->pad[0], BTN_B);
+	pads_expect(test, cfg->pad[1], 0);
+	pads_expect(test, cfg->pad[4], 0);
+	pads_expect(test, cfg->pad[5], BTN_X);
+	pads_expect(test, cfg->pad[6], BTN_TL);
+	pads_expect(test, cfg->pad[7], BTN_TR);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 8);
+}
+
+static void pads_test_fourscore_connected(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+	unsigned int g1 = cfg->gpio[2], g2 = cfg->gpio[3];
+
+	KUNIT_EXPECT_FALSE(test, fourscore_connected(g1, g2, cap->data));
+
+	fourscore_sign(cap, g1, g2);
+	KUNIT_EXPECT_TRUE(test, fourscore_connected(g1, g2, cap->data));
+	KUNIT_EXPECT_FALSE(test, fourscore_connected(g2, g1, cap->data));
+
+	// A SNES pad with all buttons pressed shifts out ones after its 16 bits, not the signature.
+	cap->data[16] |= g1;
+	KUNIT_EXPECT_FALSE(test, fourscore_connected(g1, g2, cap->data));
+}
+
+static void pads_test_fourscore(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cfg->fourscore_enabled = true;
+	fourscore_sign(cap, cfg->gpio[2], cfg->gpio[3]);
+	cap->data[0] |= cfg->gpio[2];	// B, player 1
+	cap->data[1] |= cfg->gpio[3];	// Y, player 2
+	cap->data[8 + 2] |= cfg->gpio[2];	// Select, player 3
+	cap->data[8 + 3] |= cfg->gpio[3];	// Start, player 4
+	pads_update(cfg, cap);
+
+	pads_expect(test, cfg->pad[0], BTN_B);
+	pads_expect(test, cfg->pad[1], BTN_Y);
+	pads_expect(test, cfg->pad[2], BTN_SELECT);
+	pads_expect(test, cfg->pad[3], BTN_START);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 4);
+}
+
+static void pads_test_fourscore_dual(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+
+	cfg->fourscore_enabled = true;
+	fourscore_sign(cap, cfg->gpio[2], cfg->gpio[3]);
+	fourscore_sign(cap, cfg->gpio[6], cfg->gpio[7]);
+	cap->data[0] |= cfg->gpio[6];	// B, player 5
+	cap->data[1] |= cfg->gpio[7];	// Y, player 6
+	cap->data[8 + 2] |= cfg->gpio[6];	// Select, player 7
+	cap->data[8 + 3] |= cfg->gpio[7];	// Start, player 8
+	pads_update(cfg, cap);
+
+	pads_expect(test, cfg->pad[0], 0);
+	pads_expect(test, cfg->pad[4], BTN_B);
+	pads_expect(test, cfg->pad[5], BTN_Y);
+	pads_expect(test, cfg->pad[6], BTN_SELECT);
+	pads_expect(test, cfg->pad[7], BTN_START);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 8);
+
+	// Without its signature the second Four Score is not read.
+	cap->data[18] &= ~cfg->gpio[7];
+	pads_update(cfg, cap);
+	pads_expect(test, cfg->pad[4], 0);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 4);
+}
+
+static void pads_test_multitap_connected(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cfg->multitap_enabled = true;
+	KUNIT_EXPECT_EQ(test, multitap_connected(cfg), 0);
+
+	bus.taps = cfg->gpio[3];
+	KUNIT_EXPECT_EQ(test, multitap_connected(cfg), cfg->gpio[3]);
+
+	// Port 1 is only checked when a second Multitap can be connected.
+	bus.taps |= cfg->gpio[2];
+	KUNIT_EXPECT_EQ(test, multitap_connected(cfg), cfg->gpio[3]);
+	cfg->n_gpios = MAX_NUMBER_OF_GPIOS;
+	KUNIT_EXPECT_EQ(test, multitap_connected(cfg), cfg->gpio[3] | cfg->gpio[2]);
+
+	bus.taps = cfg->gpio[2];
+	KUNIT_EXPECT_EQ(test, multitap_connected(cfg), cfg->gpio[2]);
+
+	// D0 is released again
+	KUNIT_EXPECT_EQ(test, bus.dir & (cfg->gpio[2] | cfg->gpio[3]), 0);
+}
+
+static void pads_test_detect(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	bus.taps = cfg->gpio[3];
+	pads_detect(cfg);
+	KUNIT_EXPECT_EQ(test, cfg->taps, 0);
+
+	cfg->multitap_enabled = true;
+	pads_detect(cfg);
+	KUNIT_EXPECT_EQ(test, cfg->taps, cfg->gpio[3]);
+
+	bus.taps = 0;
+	pads_detect(cfg);
+	KUNIT_EXPECT_EQ(test, cfg->taps, 0);
+}
+
+static void pads_test_players(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_MULTITAP_DUAL);
+	unsigned int d = cfg->gpio[2] | cfg->gpio[3] | cfg->gpio[4] | cfg->gpio[6];
+	int half = BITS_LENGTH_MULTITAP / 2, i;
+
+	// Start on all 8 players
+	cfg->multitap_enabled = true;
+	cap->data[3] |= d;
+	cap->data[3 + half] |= d;
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 8);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_START, cfg->pad[7]->key));
+
+	// The Multitap on port 1 is unplugged, players 6 - 8 are released.
+	cap->type = PADS_CAPTURE_MULTITAP;
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 5);
+	for (i = 5; i < NUMBER_OF_INPUT_DEVICES; i++) {
+		pads_expect(test, cfg->pad[i], 0);
+	}
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_START, cfg->pad[4]->key));
+
+	// Both are unplugged, players 3 - 5 are released, the d-pads too.
+	memset(cap->data, 0, sizeof(cap->data));
+	cap->type = PADS_CAPTURE_STANDARD;
+	cap->data[0] |= cfg->gpio[3];
+	cap->data[4] |= cfg->gpio[3];
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 2);
+	for (i = 2; i < NUMBER_OF_INPUT_DEVICES; i++) {
+		pads_expect(test, cfg->pad[i], 0);
+	}
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_B, cfg->pad[1]->key));
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->pad[1], ABS_Y), -1);
+
+	// Pads that do not exist are skipped.
+	input_unregister_device(cfg->pad[7]);
+	cfg->pad[7] = NULL;
+	cfg->player_mode = NUMBER_OF_INPUT_DEVICES;
+	pads_players(cfg, 2);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 2);
+}
+
+static void pads_test_mouse(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+	unsigned int g = cfg->gpio[2];
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cfg->mouse_enabled = true;
+	cap->data[0] |= g;	// B, pad on port 1
+	cap->data[4] |= g;	// Up
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_B, cfg->pad[0]->key));
+
+	// A mouse is plugged into port 1, the buttons the pad held are released.
+	memset(cap->data, 0, sizeof(cap->data));
+	cap->data[9] |= g;	// Left button
+	cap->data[15] |= g;	// Signature
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->mouse_ports, g);
+	pads_expect(test, cfg->pad[0], 0);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_LEFT, cfg->mouse[0]->key));
+
+	// Motion is read from the 32 bit capture, up is negative.
+	cap->type = PADS_CAPTURE_MOUSE;
+	cap->data[16] |= g;	// Up
+	cap->data[23] |= g;	// by 1
+	cap->data[30] |= g;	// Right by 2
+	mouse_track(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->mouse_dy[0], -1);
+	KUNIT_EXPECT_EQ(test, cfg->mouse_dx[0], 2);
+
+	// Unplugged, the mouse buttons are released.
+	memset(cap->data, 0, sizeof(cap->data));
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, cfg->mouse_ports, 0);
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_LEFT, cfg->mouse[0]->key));
+}
+
+static void pads_test_mouse_fourscore(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cfg->mouse_enabled = true;
+	cfg->fourscore_enabled = true;
+	fourscore_sign(cap, cfg->gpio[2], cfg->gpio[3]);
+	cap->data[8 + 7] |= cfg->gpio[2];	// Right alone on player 3, bits 12 - 15 read like a mouse
+	cap->data[8 + 7] |= cfg->gpio[3];	// and on player 4
+	pads_update(cfg, cap);
+
+	KUNIT_EXPECT_EQ(test, cfg->mouse_ports, 0);
+	KUNIT_EXPECT_FALSE(test, cfg->mouse_cycle);
+	KUNIT_EXPECT_EQ(test, cfg->player_mode, 4);
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->pad[2], ABS_X), 1);
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->pad[3], ABS_X), 1);
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_LEFT, cfg->mouse[0]->key));
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_RIGHT, cfg->mouse[0]->key));
+}
+
+static void pads_test_paddle(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+	int i;
+
+	cfg->paddle_enabled = true;
+	for (i = 0; i < PADDLE_BITS; i++) {
+		if (0xA5 & (0x80 >> i)) {
+			cap->data[i] |= cfg->gpio[4];	// Position, most significant bit first
+		}
+	}
+	cap->data[0] |= cfg->gpio[6];	// Button on port2_d3
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->paddle, ABS_X), 0xA5);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_A, cfg->paddle->key));
+
+	// Without port2_d3 the button is not read.
+	cfg->n_gpios = NUMBER_OF_GPIOS;
+	cap->data[0] &= ~cfg->gpio[6];
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_A, cfg->paddle->key));
+}
+
+static void pads_test_zapper(struct kunit *test) {
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap = pads_test_capture(test, PADS_CAPTURE_STANDARD);
+
+	// port2_d3 high senses light, port2_d4 low is the pulled trigger. The capture holds the negated levels.
+	cfg->zapper_enabled = true;
+	cap->data[0] = cfg->gpio[7];
+	cap->latch = 1000;
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_TRUE(test, test_bit(BTN_TRIGGER, cfg->zapper->key));
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->zapper, ABS_MISC), 1);
+
+	cap->data[0] = cfg->gpio[6];
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_TRIGGER, cfg->zapper->key));
+	KUNIT_EXPECT_EQ(test, input_abs_get_val(cfg->zapper, ABS_MISC), 0);
+
+	// While it is sampled at high rate the Zapper is not reported from the reads.
+	cfg->zapper_sampling = true;
+	cap->data[0] = cfg->gpio[7];
+	pads_update(cfg, cap);
+	KUNIT_EXPECT_FALSE(test, test_bit(BTN_TRIGGER, cfg->zapper->key));
+}
+
+/**
+ * Fill a capture with buttons that change from round to round.
+ *
+ * @param cap The capture
+ * @param round The round
+ * @param bits Number of bits of the capture
+ */
+static void timing_fill(struct pads_capture *cap, unsigned int round, int bits) {
+	u32 seed = round * 2654435761u;
+	int i;
+
+	for (i = 0; i < bits; i++) {
+		seed = seed * 1103515245u + 12345u;
+		cap->data[i] = seed;
+	}
+}
+
+/**
+ * Time pads_update for every kind of capture and report the time per capture. Nothing is expected, the times
+ * depend on the machine the suite runs on.
+ */
+static void pads_test_timing(struct kunit *test) {
+	static const struct {
+		const char *name;
+		u32 type;
+		int bits;
+		bool fourscore;
+		bool mouse;
+	} kinds[] = {
+		{ "standard", PADS_CAPTURE_STANDARD, BITS_LENGTH, false, false },
+		{ "fourscore", PADS_CAPTURE_STANDARD, BITS_LENGTH, true, false },
+		{ "mouse", PADS_CAPTURE_MOUSE, BITS_LENGTH_MOUSE, false, true },
+		{ "multitap", PADS_CAPTURE_MULTITAP, BITS_LENGTH_MULTITAP, false, false },
+		{ "multitap_dual", PADS_CAPTURE_MULTITAP_DUAL, BITS_LENGTH_MULTITAP, false, false },
+	};
+	struct pads_config *cfg = test->priv;
+	struct pads_capture *cap[2];
+	unsigned int round;
+	u64 start, ns;
+	int k;
+
+	cap[0] = pads_test_capture(test, 0);
+	cap[1] = pads_test_capture(test, 0);
+	for (k = 0; k < ARRAY_SIZE(kinds); k++) {
+		cfg->multitap_enabled = kinds[k].type == PADS_CAPTURE_MULTITAP || kinds[k].type == PADS_CAPTURE_MULTITAP_DUAL;
+		cfg->fourscore_enabled = kinds[k].fourscore;
+		cfg->mouse_enabled = kinds[k].mouse;
+
+		// Two captures are decoded in turn, so every decode reports changes.
+		for (round = 0; round < 2; round++) {
+			memset(cap[round]->data, 0, sizeof(cap[round]->data));
+			cap[round]->type = kinds[k].type;
+			timing_fill(cap[round], round, kinds[k].bits);
+			if (kinds[k].fourscore) {
+				memset(&cap[round]->data[16], 0, 8 * sizeof(u32));
+				fourscore_sign(cap[round], cfg->gpio[2], cfg->gpio[3]);
+			}
+			if (kinds[k].mouse) {
+				cap[round]->data[12] &= ~cfg->gpio[2];
+				cap[round]->data[13] &= ~cfg->gpio[2];
+				cap[round]->data[14] &= ~cfg->gpio[2];
+				cap[round]->data[15] |= cfg->gpio[2];
+			}
+		}
+
+		start = ktime_get_ns();
+		for (round = 0; round < TIMING_ROUNDS; round++) {
+			pads_update(cfg, cap[round & 1]);
+		}
+		ns = ktime_get_ns() - start;
+		kunit_info(test, "%s: %llu ns per capture\n", kinds[k].name, (unsigned long long)(ns / TIMING_ROUNDS));
+	}
+}
+
+static struct kunit_case pads_test_cases[] = {
+	KUNIT_CASE(pads_test_standard),
+	KUNIT_CASE(pads_test_multitap),
+	KUNIT_CASE(pads_test_multitap_dual),
+	KUNIT_CASE(pads_test_fourscore_connected),
+	KUNIT_CASE(pads_test_fourscore),
+	KUNIT_CASE(pads_test_fourscore_dual),
+	KUNIT_CASE(pads_test_multitap_connected),
+	KUNIT_CASE(pads_test_detect),
+	KUNIT_CASE(pads_test_players),
+	KUNIT_CASE(pads_test_mouse),
+	KUNIT_CASE(pads_test_mouse_fourscore),
+	KUNIT_CASE(pads_test_paddle),
+	KUNIT_CASE(pads_test_zapper),
+	KUNIT_CASE(pads_test_timing),
+	{}
+};
+
+static struct kunit_suite pads_test_suite = {
+	.name = "snescon_pads",
+	.init = pads_test_init,
+	.exit = pads_test_exit,
+	.test_cases = pads_test_cases,
+};
+
+kunit_test_suite(pads_test_suite);
+
+MODULE_AUTHOR("Christian Isaksson");
+MODULE_AUTHOR("Karl Thoren <karl.h.thoren@gmail.com>");
+MODULE_DESCRIPTION("KUnit tests for the NES, SNES, gamepad driver");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,1655 @@
+/*
+ * NES, SNES, gamepad driver for Raspberry Pi
+ *
+ *  Copyright (c) 2014	Christian Isaksson
+ *  Copyright (c) 2014	Karl Thoren <karl.h.thoren@gmail.com>
+ */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/async.h>
+#include <linux/input.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/platform_device.h>
+#include <linux/pm_runtime.h>
+#include <linux/version.h>
+#include "gpio.h"
+#include "pads.h"
+
+/* _      _                     _                        _ 
+  | |    (_)                   | |                      | |
+  | |     _ _ __  _   ___  __  | | _____ _ __ _ __   ___| |
+  | |    | | '_ \| | | \ \/ /  | |/ / _ \ '__| '_ \ / _ \ |
+  | |____| | | | | |_| |>  <   |   <  __/ |  | | | |  __/ |
+  |______|_|_| |_|\__,_/_/\_\  |_|\_\___|_|  |_| |_|\___|_|
+*/
+
+#define REFRESH_RATE 100
+#define REFRESH_TIME HZ/REFRESH_RATE
+#define ZAPPER_WINDOW_MS 50	// The Zapper light sense is sampled for 3 frames after the trigger is released.
+
+#define MULTITAP_DETECT_MS 500	// Period of the Multitap detection, when the backend can not detect it in the reads.
+
+// timer_setup came with 4.15, hrtimers that run in softirq context like the timer with 4.16.
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 16, 0)
+#error "The driver needs kernel 4.16 or newer"
+#endif
+
+#define SAMPLER_MODE HRTIMER_MODE_REL_SOFT
+
+// Timer functions that were renamed, the old names were removed in 6.15 and 6.16.
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
+#define timer_delete_sync del_timer_sync
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 16, 0)
+#define timer_container_of from_timer
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 13, 0)
+static inline void hrtimer_setup(struct hrtimer *timer, enum hrtimer_restart (*function)(struct hrtimer *),
+				 clockid_t clock_id, enum hrtimer_mode mode) {
+	hrtimer_init(timer, clock_id, mode);
+	timer->function = function;
+}
+#endif
+
+MODULE_AUTHOR("Christian Isaksson");
+MODULE_AUTHOR("Karl Thoren <karl.h.thoren@gmail.com>");
+MODULE_DESCRIPTION("NES, SNES, gamepad driver for Raspberry Pi");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("1.0.0");
+
+#define CAPTURE_DEPTH 6000 // One minute of captures at the default refresh rate.
+#define SUSPEND_DELAY_MS 1000 // Time the pins stay set up after the last device was closed.
+#define PM_DEVICE_NAME "snescon" // The gpiod backend registers a device named after the module.
+
+/*
+ * Bounded ring buffer of bus captures, used to record a session and replay it in place of the bus.
+ *
+ * The buffer is allocated the first time it is used. All fields are protected by lock, which is also taken from the timers.
+ */
+struct capture_buffer {
+	struct pads_capture *captures;
+	spinlock_t lock;
+	unsigned int head;	// Index where the next capture will be stored.
+	unsigned int count;	// Number of valid captures in the buffer.
+	unsigned int replay_pos;	// Number of captures replayed since replay was started.
+	bool recording;
+	bool replaying;
+	unsigned long decoded;	// Number of captures decoded since the statistics were reset.
+	u64 decode_ns_total;
+	u64 decode_ns_max;
+	unsigned long acquired;	// Number of captures read from the bus since the statistics were reset.
+	u64 acquire_ns_total;	// Wall time, from the first to the last bus access.
+	u64 acquire_ns_max;
+	u64 acquire_cpu_ns_total;	// CPU time, the same as the wall time for the delay engine.
+	u64 acquire_cpu_ns_max;
+};
+
+/*
+ * Structure that contain pads configuration, timer and mutex.
+ */
+struct snescon_config {
+	struct pads_config pads_cfg;
+	struct timer_list timer;
+	struct hrtimer sampler;	// Polls the bus faster than the refresh rate while a SNES Mouse is connected.
+	unsigned int sample_cnt;	// Samples taken since the pads were last reported.
+	unsigned int mouse_rate;	// Rate in Hz of the sampler.
+	bool polling;	// Cleared to keep the timer and the sampler from rearming each other when stopping.
+	struct delayed_work detect;	// Detects SNES Multitaps between the reads, see gpio_atomic_direction.
+	struct hrtimer zapper_sampler;	// Samples the light sense of the Zapper at high rate after the trigger is pulled.
+	unsigned int zapper_rate;	// Rate in Hz of the Zapper sampler.
+	ktime_t zapper_until;	// Time when the Zapper sampler stops.
+	bool lowcpu;	// Read the bus with the low-CPU engine, which waits for the clock edges with the bus timer.
+	struct hrtimer bus_timer;	// Does the steps of a bus transaction of the low-CPU engine.
+	struct pads_bus bus;	// The transaction, and the capture it reads.
+	struct pads_capture bus_cap;
+	bool bus_sampled;	// Set if the transaction was started by the sampler, otherwise by the timer.
+	u64 bus_start;	// Time in ns when the transaction was started.
+	u64 bus_cpu_ns;	// Time spent in the steps of the transaction.
+	struct mutex mutex;
+	struct mutex reconfig;	// Serializes reconfigurations, taken before mutex.
+	bool paused;	// Set while the driver is reconfigured, the bus is not polled even if devices are open.
+	bool suspended;	// Set while the system sleeps, the bus is not polled even if devices are open.
+	struct platform_device *pdev;	// Device the power management of the bus is bound to.
+	bool live;	// Set once the driver is initialized, changes of the configuration are then applied with snescon_reconfigure.
+	bool async_register;	// Register the input devices in the background, see snescon_register.
+	int register_status;	// Result of the registration of the input devices, the driver is unusable if it failed.
+	int driver_usage_cnt;
+	unsigned int gpio_id[MAX_NUMBER_OF_GPIOS];
+	unsigned int gpio_id_cnt; // Counter used in communication with userspace. Should be set to NUMBER_OF_GPIOS or MAX_NUMBER_OF_GPIOS if parameter gpio_id is valid.
+	struct capture_buffer capture;
+	struct dentry *debugfs;
+	ktime_t init_start;	// Time when the driver started to initialize.
+};
+
+/*
+ * The part of the configuration that can be changed while the driver is running.
+ */
+struct snescon_settings {
+	unsigned int gpio_id[MAX_NUMBER_OF_GPIOS];
+	unsigned int gpio_id_cnt;
+	bool multitap;
+	bool fourscore;
+	bool mouse;
+	bool paddle;
+	bool zapper;
+	bool lowcpu;
+};
+
+/**
+ * Get a capture by its age in the buffer. Must be called with the lock held.
+ *
+ * @param buf The capture buffer
+ * @param idx Index of the capture, 0 being the oldest
+ * @return The capture
+ */
+static struct pads_capture *capture_get(struct capture_buffer *buf, unsigned int idx) {
+	return &buf->captures[(buf->head + CAPTURE_DEPTH - buf->count + idx) % CAPTURE_DEPTH];
+}
+
+/**
+ * Empty the buffer and reset the statistics. Must be called with the lock held.
+ *
+ * @param buf The capture buffer
+ */
+static void capture_reset(struct capture_buffer *buf) {
+	buf->head = 0;
+	buf->count = 0;
+	buf->replay_pos = 0;
+	buf->decoded = 0;
+	buf->decode_ns_total = 0;
+	buf->decode_ns_max = 0;
+	buf->acquired = 0;
+	buf->acquire_ns_total = 0;
+	buf->acquire_ns_max = 0;
+	buf->acquire_cpu_ns_total = 0;
+	buf->acquire_cpu_ns_max = 0;
+}
+
+/**
+ * Allocate the capture storage if it has not been allocated yet.
+ *
+ * @param buf The capture buffer
+ * @return 0 on success, otherwise -ENOMEM
+ */
+static int capture_alloc(struct capture_buffer *buf) {
+	struct pads_capture *captures;
+	unsigned long flags;
+
+	if (buf->captures) {
+		return 0;
+	}
+
+	captures = vmalloc(CAPTURE_DEPTH * sizeof(*captures));
+	if (!captures) {
+		return -ENOMEM;
+	}
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (!buf->captures) {
+		buf->captures = captures;
+		captures = NULL;
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	vfree(captures);
+	return 0;
+}
+
+/**
+ * Store a capture in the buffer if recording is enabled. The oldest capture is overwritten when the buffer is full.
+ *
+ * @param buf The capture buffer
+ * @param cap The capture to store
+ */
+static void capture_record(struct capture_buffer *buf, const struct pads_capture *cap) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (buf->recording) {
+		buf->captures[buf->head] = *cap;
+		buf->head = (buf->head + 1) % CAPTURE_DEPTH;
+		if (buf->count < CAPTURE_DEPTH) {
+			buf->count++;
+		}
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+}
+
+/**
+ * Fetch the next capture to replay. Replay is stopped when the last capture has been fetched.
+ *
+ * @param buf The capture buffer
+ * @param cap Capture to store the replayed data in
+ * @return true if a capture was fetched, false if the bus should be read instead
+ */
+static bool capture_replay(struct capture_buffer *buf, struct pads_capture *cap) {
+	bool replayed = false;
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (buf->replaying) {
+		if (buf->replay_pos < buf->count) {
+			*cap = *capture_get(buf, buf->replay_pos);
+			buf->replay_pos++;
+			replayed = true;
+		} else {
+			buf->replaying = false;
+		}
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	return replayed;
+}
+
+/**
+ * Account the time spent decoding and reporting one capture.
+ *
+ * @param buf The capture buffer
+ * @param ns Time spent in nanoseconds
+ */
+static void capture_account(struct capture_buffer *buf, u64 ns) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	buf->decoded++;
+	buf->decode_ns_total += ns;
+	if (ns > buf->decode_ns_max) {
+		buf->decode_ns_max = ns;
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+}
+
+/**
+ * Account the time spent reading one capture from the bus.
+ *
+ * @param buf The capture buffer
+ * @param ns Time spent in nanoseconds
+ * @param cpu_ns Time the CPU was busy with the bus in nanoseconds
+ */
+static void capture_account_bus(struct capture_buffer *buf, u64 ns, u64 cpu_ns) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	buf->acquired++;
+	buf->acquire_ns_total += ns;
+	if (ns > buf->acquire_ns_max) {
+		buf->acquire_ns_max = ns;
+	}
+	buf->acquire_cpu_ns_total += cpu_ns;
+	if (cpu_ns > buf->acquire_cpu_ns_max) {
+		buf->acquire_cpu_ns_max = cpu_ns;
+	}
+	spin_unlock_irqrestore(&buf->lock, flags);
+}
+
+/**
+ * Read a capture from the bus and account the time it took. The delay engine busy-waits between the clock edges, so
+ * the CPU is busy all the time.
+ *
+ * @param cfg The driver configuration
+ * @param cap Capture to store the read data in
+ */
+static void snescon_acquire(struct snescon_config *cfg, struct pads_capture *cap) {
+	u64 start, ns;
+
+	start = ktime_get_ns();
+	pads_acquire(&(cfg->pads_cfg), cap);
+	ns = ktime_get_ns() - start;
+	capture_account_bus(&cfg->capture, ns, ns);
+}
+
+/**
+ * Start reading the bus with the low-CPU engine. The first step is done right away, the bus timer does the others and
+ * reports the capture.
+ *
+ * @param cfg The driver configuration
+ * @param sampled Set if the read is started by the sampler, otherwise by the timer
+ */
+static void snescon_bus_start(struct snescon_config *cfg, bool sampled) {
+	unsigned int us;
+
+	cfg->bus_sampled = sampled;
+	cfg->bus_start = ktime_get_ns();
+	pads_bus_start(&(cfg->pads_cfg), &cfg->bus, &cfg->bus_cap);
+	us = pads_bus_step(&(cfg->pads_cfg), &cfg->bus);
+	cfg->bus_cpu_ns = ktime_get_ns() - cfg->bus_start;
+	hrtimer_start(&cfg->bus_timer, ns_to_ktime(us * NSEC_PER_USEC), SAMPLER_MODE);
+}
+
+/**
+ * Report a capture to all pads and account the time it took.
+ *
+ * @param cfg The driver configuration
+ * @param cap The capture to report
+ */
+static void snescon_report(struct snescon_config *cfg, const struct pads_capture *cap) {
+	u64 start;
+
+	start = ktime_get_ns();
+	pads_update(&(cfg->pads_cfg), cap);
+	capture_account(&cfg->capture, ktime_get_ns() - start);
+}
+
+/**
+ * Check if the sampler should own the bus, which is the case while a SNES Mouse is connected and no session is replayed.
+ *
+ * @param cfg The driver configuration
+ * @return true if the sampler should run
+ */
+static bool snescon_sampling(struct snescon_config *cfg) {
+	return cfg->pads_cfg.mouse_ports && cfg->mouse_rate > REFRESH_RATE && !cfg->capture.replaying;
+}
+
+/**
+ * Continue polling after the timer reported a capture. Starts the Zapper sampler when the trigger was pulled, and
+ * arms either the timer or the sampler for the next poll.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_polled(struct snescon_config *cfg) {
+	if (!cfg->polling) {
+		return;
+	}
+
+	if (cfg->pads_cfg.zapper_trigger && !cfg->pads_cfg.zapper_sampling && cfg->zapper_rate > REFRESH_RATE) {
+		// The trigger was pulled, the game is about to flash the target. Sample the light sense at high rate.
+		cfg->pads_cfg.zapper_sampling = true;
+		cfg->zapper_until = ktime_add_ns(ktime_get(), ZAPPER_WINDOW_MS * NSEC_PER_MSEC);
+		hrtimer_start(&cfg->zapper_sampler, ns_to_ktime(NSEC_PER_SEC / cfg->zapper_rate), SAMPLER_MODE);
+	}
+
+	if (snescon_sampling(cfg)) {
+		// Hand the bus over to the sampler, which also takes over reporting.
+		cfg->sample_cnt = 0;
+		hrtimer_start(&cfg->sampler, ns_to_ktime(NSEC_PER_SEC / cfg->mouse_rate), SAMPLER_MODE);
+	} else {
+		mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
+	}
+}
+
+/**
+ * Timer that read and update all pads. With the low-CPU engine it only starts the read, the bus timer reports the
+ * capture and arms the next poll.
+ * 
+ * @param t The timer
+ */
+static void snescon_timer(struct timer_list *t) {
+	struct snescon_config *cfg = timer_container_of(cfg, t, timer);
+	struct pads_capture cap;
+
+	if (capture_replay(&cfg->capture, &cap)) {
+		// Replayed events are stamped with the time they are replayed.
+		cap.latch = ktime_to_ns(ktime_get());
+	} else if (cfg->lowcpu) {
+		snescon_bus_start(cfg, false);
+		return;
+	} else {
+		snescon_acquire(cfg, &cap);
+		capture_record(&cfg->capture, &cap);
+	}
+
+	snescon_report(cfg, &cap);
+	snescon_polled(cfg);
+}
+
+/**
+ * Handle a capture of the sampler. The motion of every sample is accumulated, all pads are reported at the refresh
+ * rate.
+ *
+ * @param cfg The driver configuration
+ * @param cap The capture
+ * @return true if the sampler keeps the bus, false if it was handed back to the timer or polling is stopped
+ */
+static bool snescon_sampled(struct snescon_config *cfg, const struct pads_capture *cap) {
+	if (++cfg->sample_cnt >= cfg->mouse_rate / REFRESH_RATE) {
+		cfg->sample_cnt = 0;
+		snescon_report(cfg, cap);
+	} else {
+		mouse_track(&(cfg->pads_cfg), cap);
+	}
+
+	if (!cfg->polling) {
+		return false;
+	}
+
+	if (!snescon_sampling(cfg)) {
+		// Hand the bus back to the timer.
+		mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Sampler that polls the bus at mouse_rate while a SNES Mouse is connected. The motion of every sample is accumulated,
+ * all pads are reported at the refresh rate.
+ *
+ * @param t The sampler
+ * @return HRTIMER_RESTART while a mouse is connected
+ */
+static enum hrtimer_restart snescon_sampler(struct hrtimer *t) {
+	struct snescon_config *cfg = container_of(t, struct snescon_config, sampler);
+	struct pads_capture cap;
+
+	if (cfg->lowcpu) {
+		// The bus timer arms the sampler again once the capture is read.
+		snescon_bus_start(cfg, true);
+		return HRTIMER_NORESTART;
+	}
+
+	snescon_acquire(cfg, &cap);
+	capture_record(&cfg->capture, &cap);
+	if (!snescon_sampled(cfg, &cap)) {
+		return HRTIMER_NORESTART;
+	}
+
+	hrtimer_forward_now(t, ns_to_ktime(NSEC_PER_SEC / cfg->mouse_rate));
+	return HRTIMER_RESTART;
+}
+
+/**
+ * Bus timer of the low-CPU engine. Does the next step of the transaction and sleeps until the one after is due. The
+ * CPU time of the read is the time spent in the steps, the timer interrupts are not included.
+ *
+ * @param t The bus timer
+ * @return HRTIMER_RESTART until the capture is read
+ */
+static enum hrtimer_restart snescon_bus(struct hrtimer *t) {
+	struct snescon_config *cfg = container_of(t, struct snescon_config, bus_timer);
+	struct pads_capture *cap = &cfg->bus_cap;
+	unsigned int us;
+	u64 start, end;
+	s64 left;
+
+	start = ktime_get_ns();
+	us = pads_bus_step(&(cfg->pads_cfg), &cfg->bus);
+	end = ktime_get_ns();
+	cfg->bus_cpu_ns += end - start;
+	if (us) {
+		hrtimer_forward_now(t, ns_to_ktime(us * NSEC_PER_USEC));
+		return HRTIMER_RESTART;
+	}
+
+	capture_account_bus(&cfg->capture, end - cfg->bus_start, cfg->bus_cpu_ns);
+	capture_record(&cfg->capture, cap);
+	if (!cfg->bus_sampled) {
+		snescon_report(cfg, cap);
+		snescon_polled(cfg);
+	} else if (snescon_sampled(cfg, cap)) {
+		// The sample period counts from when the read was started, as it does for the delay engine.
+		left = NSEC_PER_SEC / cfg->mouse_rate - (s64)(end - cfg->bus_start);
+		hrtimer_start(&cfg->sampler, ns_to_ktime(max_t(s64, left, 0)), SAMPLER_MODE);
+	}
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * Sampler that reads the Zapper at zapper_rate while the trigger is pulled and for ZAPPER_WINDOW_MS after. The Zapper
+ * is not clocked, so it is sampled without a bus transaction and independently of the timer and the bus sampler.
+ *
+ * @param t The Zapper sampler
+ * @return HRTIMER_RESTART until the sampling window has passed
+ */
+static enum hrtimer_restart snescon_zapper_sampler(struct hrtimer *t) {
+	struct snescon_config *cfg = container_of(t, struct snescon_config, zapper_sampler);
+	ktime_t now = ktime_get();
+
+	zapper_report(&(cfg->pads_cfg), gpio_read_all(), ktime_to_ns(now));
+	if (cfg->pads_cfg.zapper_trigger) {
+		cfg->zapper_until = ktime_add_ns(now, ZAPPER_WINDOW_MS * NSEC_PER_MSEC);
+	}
+
+	if (!cfg->polling || ktime_after(now, cfg->zapper_until)) {
+		cfg->pads_cfg.zapper_sampling = false;
+		return HRTIMER_NORESTART;
+	}
+
+	hrtimer_forward_now(t, ns_to_ktime(NSEC_PER_SEC / cfg->zapper_rate));
+	return HRTIMER_RESTART;
+}
+
+/**
+ * Stop polling the bus. The timer, the sampler and the bus timer can arm each other, so they are stopped again once
+ * the others are known to be stopped. A transaction of the low-CPU engine that was cut short leaves the bus idle.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_stop(struct snescon_config *cfg) {
+	cfg->polling = false;
+	timer_delete_sync(&cfg->timer);
+	hrtimer_cancel(&cfg->sampler);
+	hrtimer_cancel(&cfg->bus_timer);
+	timer_delete_sync(&cfg->timer);
+	hrtimer_cancel(&cfg->sampler);
+	hrtimer_cancel(&cfg->bus_timer);
+	pads_bus_abort(&(cfg->pads_cfg), &cfg->bus);
+	hrtimer_cancel(&cfg->zapper_sampler);
+	cfg->pads_cfg.zapper_sampling = false;
+}
+
+/**
+ * Start polling the bus if a device is open, unless the driver is reconfigured or the system sleeps. Must be called
+ * with the mutex held and polling stopped.
+ *
+ * @param cfg The driver configuration
+ * @param now Poll right away, otherwise one refresh period from now
+ */
+static void snescon_start(struct snescon_config *cfg, bool now) {
+	if (cfg->driver_usage_cnt <= 0 || cfg->paused || cfg->suspended) {
+		return;
+	}
+
+	if (!gpio_atomic_direction && cfg->pads_cfg.multitap_enabled) {
+		// The bus is idle, D0 can be driven here. The reads use what is detected until the next detection.
+		pads_detect(&(cfg->pads_cfg));
+		schedule_delayed_work(&cfg->detect, msecs_to_jiffies(MULTITAP_DETECT_MS));
+	}
+
+	cfg->polling = true;
+	if (now) {
+		// The timer is stopped, it is armed again by the poll. Run it the way the timer would.
+		local_bh_disable();
+		snescon_timer(&cfg->timer);
+		local_bh_enable();
+	} else {
+		mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
+	}
+}
+
+/**
+ * Detect the SNES Multitaps when the backend can not change the direction of D0 from the timers. Polling is stopped
+ * for the detection, which is done by snescon_start, and the bus is read again right after.
+ *
+ * @param work The detect work
+ */
+static void snescon_detect(struct work_struct *work) {
+	struct snescon_config *cfg = container_of(to_delayed_work(work), struct snescon_config, detect);
+
+	mutex_lock(&cfg->mutex);
+	// Polling that was stopped is started again with a detection of its own.
+	if (cfg->polling) {
+		snescon_stop(cfg);
+		snescon_start(cfg, true);
+	}
+	mutex_unlock(&cfg->mutex);
+}
+
+/**
+ * Take a runtime PM reference on the device of the bus, which sets up the pins if they were released.
+ *
+ * @param cfg The driver configuration
+ * @return Status
+ */
+static int snescon_pm_get(struct snescon_config *cfg) {
+	int status;
+
+	status = pm_runtime_get_sync(&cfg->pdev->dev);
+	if (status < 0) {
+		pm_runtime_put_noidle(&cfg->pdev->dev);
+		pr_err("Could not resume the bus\n");
+		return status;
+	}
+	return 0;
+}
+
+/**
+ * Drop a runtime PM reference on the device of the bus. The pins are released SUSPEND_DELAY_MS after the last one.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_pm_put(struct snescon_config *cfg) {
+	pm_runtime_mark_last_busy(&cfg->pdev->dev);
+	pm_runtime_put_autosuspend(&cfg->pdev->dev);
+}
+
+/**
+ * @brief Open function for the driver.
+ * Sets up the pins and starts the timer when the first device is opened.
+ */
+static int snescon_open(struct input_dev* dev) {
+	struct snescon_config* cfg = input_get_drvdata(dev);
+	int status;
+
+	status = mutex_lock_interruptible(&cfg->mutex);
+	if (status) {
+		return status;
+	}
+
+	if (cfg->driver_usage_cnt == 0) {
+		// First device opened. Set up the pins and start the timer.
+		status = snescon_pm_get(cfg);
+		if (status == 0) {
+			cfg->driver_usage_cnt++;
+			snescon_start(cfg, false);
+		}
+	} else {
+		cfg->driver_usage_cnt++;
+	}
+
+	mutex_unlock(&cfg->mutex);
+	return status;
+}
+
+/**
+ * @brief Close function for the driver.
+ * Disables the timer if the last device are closed, the pins are released once it has stayed closed for a while.
+ */
+static void snescon_close(struct input_dev* dev) {
+	struct snescon_config* cfg = input_get_drvdata(dev);
+
+	mutex_lock(&cfg->mutex);
+	cfg->driver_usage_cnt--;
+	if (cfg->driver_usage_cnt == 0) {
+		// Last device closed. Disable the timer.
+		snescon_stop(cfg);
+		snescon_pm_put(cfg);
+	}
+	mutex_unlock(&cfg->mutex);
+}
+
+/**
+ * Get the settings the driver currently runs with.
+ *
+ * @param cfg The driver configuration
+ * @param s Settings to fill in
+ */
+static void snescon_settings_get(struct snescon_config *cfg, struct snescon_settings *s) {
+	memcpy(s->gpio_id, cfg->gpio_id, sizeof(s->gpio_id));
+	s->gpio_id_cnt = cfg->gpio_id_cnt;
+	s->multitap = cfg->pads_cfg.multitap_enabled;
+	s->fourscore = cfg->pads_cfg.fourscore_enabled;
+	s->mouse = cfg->pads_cfg.mouse_enabled;
+	s->paddle = cfg->pads_cfg.paddle_enabled;
+	s->zapper = cfg->pads_cfg.zapper_enabled;
+	s->lowcpu = cfg->lowcpu;
+}
+
+/**
+ * Check if settings are useful.
+ *
+ * @param s The settings
+ * @return 0 if the settings are valid, otherwise -EINVAL
+ */
+static int snescon_validate(const struct snescon_settings *s) {
+	unsigned int i, j;
+
+	// All GPIOs must be set for the configuration to be prevalid.
+	if (s->gpio_id_cnt < NUMBER_OF_GPIOS) {
+		pr_err("Number of GPIO pins in gpio configuration is not correct. Expected at least %i, actual %i\n", NUMBER_OF_GPIOS, s->gpio_id_cnt);
+		return -EINVAL;
+	}
+
+	// The Zapper needs port2_d3 and port2_d4.
+	if (s->zapper && s->gpio_id_cnt < MAX_NUMBER_OF_GPIOS) {
+		pr_err("Number of GPIO pins in gpio configuration is not correct. Expected %i in order to use the Zapper, actual %i\n", MAX_NUMBER_OF_GPIOS, s->gpio_id_cnt);
+		return -EINVAL;
+	}
+
+	// The paddle and the Zapper both use port 2.
+	if (s->paddle && s->zapper) {
+		pr_err("The paddle and the Zapper can not be enabled at the same time\n");
+		return -EINVAL;
+	}
+
+	// So do the multitap and the fourscore.
+	if ((s->multitap || s->fourscore) && (s->paddle || s->zapper)) {
+		pr_err("The multitap and the fourscore can not be enabled together with the paddle or the Zapper\n");
+		return -EINVAL;
+	}
+
+	// With port2_d3 and port2_d4 set they connect a second Multitap or a second Four Score, not both.
+	if (s->multitap && s->fourscore && s->gpio_id_cnt >= MAX_NUMBER_OF_GPIOS) {
+		pr_err("The multitap and the fourscore can not be enabled together with %i GPIOs, the last two connect the second adapter\n", MAX_NUMBER_OF_GPIOS);
+		return -EINVAL;
+	}
+
+	// Final validation of the provided configuration.
+	if (!gpio_list_valid(s->gpio_id, s->gpio_id_cnt)) {
+		pr_err("One of the GPIO pins in the configuration are not valid!\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < s->gpio_id_cnt; i++) {
+		for (j = i + 1; j < s->gpio_id_cnt; j++) {
+			if (s->gpio_id[i] == s->gpio_id[j]) {
+				pr_err("GPIO %u is used more than once in the configuration\n", s->gpio_id[i]);
+				return -EINVAL;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Apply settings to the bus and the decoding. Must be called with the mutex held and polling stopped. If the new GPIOs
+ * can not be set up, the previous ones are kept.
+ *
+ * @param cfg The driver configuration
+ * @param s The settings, must be valid
+ * @return Status
+ */
+static int snescon_apply(struct snescon_config *cfg, const struct snescon_settings *s) {
+	struct pads_config *pads = &cfg->pads_cfg;
+	unsigned int i;
+	int status;
+
+	if (s->gpio_id_cnt != cfg->gpio_id_cnt || memcmp(s->gpio_id, cfg->gpio_id, s->gpio_id_cnt * sizeof(s->gpio_id[0]))) {
+		// Move the bus to the new GPIOs.
+		pads_release_gpio(pads);
+		gpio_exit();
+		status = gpio_init(s->gpio_id, s->gpio_id_cnt);
+		if (status != 0) {
+			pr_err("Setup of the new GPIOs failed, keeping the previous ones\n");
+			if (gpio_init(cfg->gpio_id, cfg->gpio_id_cnt) != 0) {
+				pr_err("Setup of the previous GPIOs failed\n");
+				return status;
+			}
+			pads_setup_gpio(pads);
+			return status;
+		}
+
+		memcpy(cfg->gpio_id, s->gpio_id, sizeof(cfg->gpio_id));
+		cfg->gpio_id_cnt = s->gpio_id_cnt;
+		pads->n_gpios = s->gpio_id_cnt;
+		for (i = 0; i < s->gpio_id_cnt; ++i) {
+			pads->gpio[i] = gpio_get_bit(s->gpio_id[i]);
+		}
+	}
+
+	pads->multitap_enabled = s->multitap;
+	pads->fourscore_enabled = s->fourscore;
+	pads->mouse_enabled = s->mouse;
+	pads->paddle_enabled = s->paddle;
+	pads->zapper_enabled = s->zapper;
+	cfg->lowcpu = s->lowcpu;
+
+	// The enabled adapters decide if port2_d4 is an output, port1_pp of a second Multitap.
+	pads_setup_gpio(pads);
+
+	// Forget what was detected with the previous settings.
+	pads->mouse_ports = 0;
+	memset(pads->mouse_dx, 0, sizeof(pads->mouse_dx));
+	memset(pads->mouse_dy, 0, sizeof(pads->mouse_dy));
+	pads->zapper_trigger = false;
+	pads->zapper_light = false;
+
+	return 0;
+}
+
+/**
+ * Change the settings of the running driver. Polling is paused, the bus is moved to the new GPIOs and the input devices
+ * that are no longer used are removed. The devices that are still used are kept, so programs that have them open are
+ * not affected. Either all settings are applied or none. Must be called with the reconfig mutex held.
+ *
+ * @param cfg The driver configuration
+ * @param s The new settings
+ * @return Status
+ */
+static int snescon_reconfigure(struct snescon_config *cfg, const struct snescon_settings *s) {
+	struct snescon_settings old;
+	ktime_t start = ktime_get();
+	int status;
+
+	status = snescon_validate(s);
+	if (status != 0) {
+		return status;
+	}
+
+	// The devices may be registered asynchronously from init.
+	async_synchronize_full();
+	if (cfg->register_status != 0) {
+		return cfg->register_status;
+	}
+	if (!cfg->live || !cfg->pads_cfg.registered) {
+		return -ENODEV;
+	}
+
+	snescon_settings_get(cfg, &old);
+
+	// The pins must be set up while the bus is moved, they are released again under the new settings.
+	status = snescon_pm_get(cfg);
+	if (status != 0) {
+		return status;
+	}
+
+	// Devices opened while paused start polling when the driver is resumed.
+	mutex_lock(&cfg->mutex);
+	cfg->paused = true;
+	snescon_stop(cfg);
+	status = snescon_apply(cfg, s);
+	mutex_unlock(&cfg->mutex);
+
+	// Opening and closing the devices take the mutex, so they are added and removed without it.
+	if (status == 0) {
+		status = pads_add(&cfg->pads_cfg);
+		if (status == 0) {
+			pads_prune(&cfg->pads_cfg);
+		} else {
+			mutex_lock(&cfg->mutex);
+			snescon_apply(cfg, &old);
+			mutex_unlock(&cfg->mutex);
+		}
+	}
+
+	mutex_lock(&cfg->mutex);
+	cfg->paused = false;
+	snescon_start(cfg, false);
+	mutex_unlock(&cfg->mutex);
+	snescon_pm_put(cfg);
+
+	if (status == 0) {
+		pr_info("Reconfigured in %lld us\n", ktime_us_delta(ktime_get(), start));
+	}
+	return status;
+}
+
+/**
+ * Parse settings written to the config file. The settings are key=value pairs separated by spaces, settings that are
+ * not listed keep their value.
+ *
+ * @param buf The written text, modified while parsing
+ * @param s Settings to update
+ * @return 0 on success, otherwise -EINVAL
+ */
+static int snescon_settings_parse(char *buf, struct snescon_settings *s) {
+	char *token, *value, *id;
+	bool *flag;
+
+	while ((token = strsep(&buf, " \t\n")) != NULL) {
+		if (!*token) {
+			continue;
+		}
+
+		value = strchr(token, '=');
+		if (!value) {
+			pr_err("Expected key=value, got %s\n", token);
+			return -EINVAL;
+		}
+		*value++ = '\0';
+
+		if (!strcmp(token, "gpio")) {
+			s->gpio_id_cnt = 0;
+			while ((id = strsep(&value, ",")) != NULL) {
+				if (s->gpio_id_cnt == MAX_NUMBER_OF_GPIOS || kstrtouint(id, 10, &s->gpio_id[s->gpio_id_cnt]) != 0) {
+					pr_err("The gpio setting takes %i to %i GPIO numbers\n", NUMBER_OF_GPIOS, MAX_NUMBER_OF_GPIOS);
+					return -EINVAL;
+				}
+				s->gpio_id_cnt++;
+			}
+			continue;
+		}
+
+		if (!strcmp(token, "multitap")) {
+			flag = &s->multitap;
+		} else if (!strcmp(token, "fourscore")) {
+			flag = &s->fourscore;
+		} else if (!strcmp(token, "mouse")) {
+			flag = &s->mouse;
+		} else if (!strcmp(token, "paddle")) {
+			flag = &s->paddle;
+		} else if (!strcmp(token, "zapper")) {
+			flag = &s->zapper;
+		} else if (!strcmp(token, "lowcpu")) {
+			flag = &s->lowcpu;
+		} else {
+			pr_err("Unknown setting %s\n", token);
+			return -EINVAL;
+		}
+
+		if (kstrtobool(value, flag) != 0) {
+			pr_err("Expected 0 or 1 for %s\n", token);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Get function for the debugfs file record.
+ */
+static int capture_record_get(void *data, u64 *val) {
+	struct capture_buffer *buf = data;
+
+	*val = buf->recording;
+	return 0;
+}
+
+/**
+ * Set function for the debugfs file record. Starting a recording discards the previous one.
+ */
+static int capture_record_set(void *data, u64 val) {
+	struct capture_buffer *buf = data;
+	int status;
+	unsigned long flags;
+
+	status = capture_alloc(buf);
+	if (status) {
+		return status;
+	}
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (val && !buf->recording) {
+		buf->replaying = false;
+		capture_reset(buf);
+	}
+	buf->recording = val;
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(capture_record_fops, capture_record_get, capture_record_set, "%llu\n");
+
+/**
+ * Get function for the debugfs file replay. Reads 0 again once all captures have been replayed.
+ */
+static int capture_replay_get(void *data, u64 *val) {
+	struct capture_buffer *buf = data;
+
+	*val = buf->replaying;
+	return 0;
+}
+
+/**
+ * Set function for the debugfs file replay. Replay always starts from the oldest capture.
+ */
+static int capture_replay_set(void *data, u64 val) {
+	struct capture_buffer *buf = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	if (val) {
+		buf->recording = false;
+		buf->replay_pos = 0;
+		buf->decoded = 0;
+		buf->decode_ns_total = 0;
+		buf->decode_ns_max = 0;
+	}
+	buf->replaying = val && buf->count > 0;
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(capture_replay_fops, capture_replay_get, capture_replay_set, "%llu\n");
+
+/**
+ * Read function for the debugfs file captures. Dumps all captures, oldest first, as an array of struct pads_capture.
+ */
+static ssize_t capture_data_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos) {
+	struct capture_buffer *buf = file->private_data;
+	struct pads_capture cap;
+	size_t done = 0, n;
+	u32 offset;
+	u64 idx;
+	bool valid;
+	unsigned long flags;
+
+	while (done < count) {
+		idx = div_u64_rem(*ppos, sizeof(cap), &offset);
+
+		spin_lock_irqsave(&buf->lock, flags);
+		valid = idx < buf->count;
+		if (valid) {
+			cap = *capture_get(buf, idx);
+		}
+		spin_unlock_irqrestore(&buf->lock, flags);
+
+		if (!valid) {
+			break;
+		}
+
+		n = min(count - done, sizeof(cap) - offset);
+		if (copy_to_user(ubuf + done, (char *)&cap + offset, n)) {
+			return done ? done : -EFAULT;
+		}
+		done += n;
+		*ppos += n;
+	}
+
+	return done;
+}
+
+/**
+ * Write function for the debugfs file captures. Loads a previously dumped session, replacing the buffer content.
+ */
+static ssize_t capture_data_write(struct file *file, const char __user *ubuf, size_t count, loff_t *ppos) {
+	struct capture_buffer *buf = file->private_data;
+	struct pads_capture cap;
+	size_t done = 0, n;
+	u32 offset;
+	u64 idx;
+	int status;
+	unsigned long flags;
+
+	status = capture_alloc(buf);
+	if (status) {
+		return status;
+	}
+
+	if (*ppos == 0) {
+		spin_lock_irqsave(&buf->lock, flags);
+		buf->recording = false;
+		buf->replaying = false;
+		capture_reset(buf);
+		spin_unlock_irqrestore(&buf->lock, flags);
+	}
+
+	while (done < count) {
+		idx = div_u64_rem(*ppos, sizeof(cap), &offset);
+		if (idx >= CAPTURE_DEPTH) {
+			return done ? done : -ENOSPC;
+		}
+
+		n = min(count - done, sizeof(cap) - offset);
+		if (copy_from_user((char *)&cap + offset, ubuf + done, n)) {
+			return done ? done : -EFAULT;
+		}
+
+		// Captures are stored in order, so the record being written is always the one after the last complete one.
+		spin_lock_irqsave(&buf->lock, flags);
+		memcpy((char *)&buf->captures[idx] + offset, (char *)&cap + offset, n);
+		if (offset + n == sizeof(cap)) {
+			buf->count = idx + 1;
+			buf->head = buf->count % CAPTURE_DEPTH;
+		}
+		spin_unlock_irqrestore(&buf->lock, flags);
+
+		done += n;
+		*ppos += n;
+	}
+
+	return done;
+}
+
+static const struct file_operations capture_data_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = capture_data_read,
+	.write = capture_data_write,
+	.llseek = default_llseek,
+};
+
+/**
+ * Read function for the debugfs file stats.
+ */
+static ssize_t capture_stats_read(struct file *file, char __user *ubuf, size_t count, loff_t *ppos) {
+	struct capture_buffer *buf = file->private_data;
+	char text[400];
+	int len;
+	unsigned long flags;
+
+	spin_lock_irqsave(&buf->lock, flags);
+	len = scnprintf(text, sizeof(text),
+			"captures: %u\nreplayed: %u\ndecoded: %lu\ndecode_ns_avg: %llu\ndecode_ns_max: %llu\n"
+			"gpio: %s\nengine: %s\nacquired: %lu\nacquire_ns_avg: %llu\nacquire_ns_max: %llu\n"
+			"acquire_cpu_ns_avg: %llu\nacquire_cpu_ns_max: %llu\n",
+			buf->count, buf->replay_pos, buf->decoded,
+			buf->decoded ? div64_u64(buf->decode_ns_total, buf->decoded) : 0,
+			buf->decode_ns_max, gpio_backend,
+			container_of(buf, struct snescon_config, capture)->lowcpu ? "lowcpu" : "delay", buf->acquired,
+			buf->acquired ? div64_u64(buf->acquire_ns_total, buf->acquired) : 0,
+			buf->acquire_ns_max,
+			buf->acquired ? div64_u64(buf->acquire_cpu_ns_total, buf->acquired) : 0,
+			buf->acquire_cpu_ns_max);
+	spin_unlock_irqrestore(&buf->lock, flags);
+
+	return simple_read_from_buffer(ubuf, count, ppos, text, len);
+}
+
+static const struct file_operations capture_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = capture_stats_read,
+	.llseek = default_llseek,
+};
+
+/**
+ * Create the debugfs files used to record and replay bus captures.
+ *
+ * /sys/kernel/debug/snescon_gpio_rpi/
+ *   record   - write 1 to start recording (discards the previous recording), 0 to stop
+ *   replay   - write 1 to feed the recorded captures to the pads instead of the bus, 0 to stop
+ *   captures - the recorded captures, can be saved and written back to replay a session later
+ *   stats    - number of captures, the time spent decoding and reporting them and the time spent reading the bus
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_debugfs_init(struct snescon_config *cfg) {
+	cfg->debugfs = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	if (IS_ERR_OR_NULL(cfg->debugfs)) {
+		cfg->debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_file("record", S_IRUSR | S_IWUSR, cfg->debugfs, &cfg->capture, &capture_record_fops);
+	debugfs_create_file("replay", S_IRUSR | S_IWUSR, cfg->debugfs, &cfg->capture, &capture_replay_fops);
+	debugfs_create_file("captures", S_IRUSR | S_IWUSR, cfg->debugfs, &cfg->capture, &capture_data_fops);
+	debugfs_create_file("stats", S_IRUSR, cfg->debugfs, &cfg->capture, &capture_stats_fops);
+}
+
+/**
+ * Remove the debugfs files and free the capture buffer.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_debugfs_exit(struct snescon_config *cfg) {
+	debugfs_remove_recursive(cfg->debugfs);
+	vfree(cfg->capture.captures);
+	cfg->capture.captures = NULL;
+}
+
+/**
+ * Module global parameter variable.
+ *
+ */
+static struct snescon_config snescon_config = {
+	.gpio_id = {2, 3, 4, 7, 10, 11}, // Default values for the GPIOs.
+	.gpio_id_cnt = NUMBER_OF_GPIOS,
+	.pads_cfg.device_name = "SNES pad",
+	.pads_cfg.open = &snescon_open,
+	.pads_cfg.close = &snescon_close,
+	.pads_cfg.multitap_enabled = 0,
+	.pads_cfg.fourscore_enabled = 0,
+	.pads_cfg.mouse_enabled = 0,
+	.pads_cfg.mouse_speed = 1,
+	.mouse_rate = 400,
+	.pads_cfg.paddle_enabled = 0,
+	.pads_cfg.zapper_enabled = 0,
+	.zapper_rate = 8000,
+};
+
+/**
+ * Show function for the sysfs file config.
+ */
+static ssize_t config_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf) {
+	struct snescon_settings s;
+	unsigned int i;
+	int len = 0;
+
+	mutex_lock(&snescon_config.reconfig);
+	snescon_settings_get(&snescon_config, &s);
+	mutex_unlock(&snescon_config.reconfig);
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "gpio=");
+	for (i = 0; i < s.gpio_id_cnt; i++) {
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s%u", i ? "," : "", s.gpio_id[i]);
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len, " multitap=%d fourscore=%d mouse=%d paddle=%d zapper=%d lowcpu=%d",
+			s.multitap, s.fourscore, s.mouse, s.paddle, s.zapper, s.lowcpu);
+	if (snescon_config.register_status != 0) {
+		// Registration in the background failed, there are no input devices.
+		len += scnprintf(buf + len, PAGE_SIZE - len, " error=%d", snescon_config.register_status);
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+/**
+ * Store function for the sysfs file config. The written settings are validated and applied together.
+ */
+static ssize_t config_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buf, size_t count) {
+	struct snescon_settings s;
+	char *text;
+	int status;
+
+	text = kstrndup(buf, count, GFP_KERNEL);
+	if (!text) {
+		return -ENOMEM;
+	}
+
+	mutex_lock(&snescon_config.reconfig);
+	snescon_settings_get(&snescon_config, &s);
+	status = snescon_settings_parse(text, &s);
+	if (status == 0) {
+		status = snescon_reconfigure(&snescon_config, &s);
+	}
+	mutex_unlock(&snescon_config.reconfig);
+
+	kfree(text);
+	return status ? status : count;
+}
+
+/*
+ * /sys/module/snescon_gpio_rpi/config
+ *   Read to get the GPIOs and the enabled devices, write key=value pairs to change them without reloading the driver.
+ */
+static struct kobj_attribute config_attr = __ATTR_RW(config);
+
+/**
+ * Set function for the module parameters multitap, fourscore and lowcpu. Once the driver is initialized, the change is
+ * validated and applied like a write to the config file.
+ */
+static int snescon_adapter_set(const char *val, const struct kernel_param *kp) {
+	struct snescon_settings s;
+	bool enable;
+	int status;
+
+	if (!snescon_config.live) {
+		return param_set_bool(val, kp);
+	}
+
+	status = kstrtobool(val, &enable);
+	if (status != 0) {
+		return status;
+	}
+
+	mutex_lock(&snescon_config.reconfig);
+	snescon_settings_get(&snescon_config, &s);
+	if (kp->arg == &snescon_config.pads_cfg.multitap_enabled) {
+		s.multitap = enable;
+	} else if (kp->arg == &snescon_config.lowcpu) {
+		s.lowcpu = enable;
+	} else {
+		s.fourscore = enable;
+	}
+	status = snescon_reconfigure(&snescon_config, &s);
+	mutex_unlock(&snescon_config.reconfig);
+
+	return status;
+}
+
+static const struct kernel_param_ops snescon_adapter_ops = {
+	.set = snescon_adapter_set,
+	.get = param_get_bool,
+};
+
+/**
+ * @brief Definition of module parameter gpio. This parameter are readable from the sysfs.
+ */
+module_param_array_named(gpio, snescon_config.gpio_id, uint, &(snescon_config.gpio_id_cnt), S_IRUGO);
+MODULE_PARM_DESC(gpio, "Mapping of the 6 or 8 gpio for the driver are as follow: <clk, latch, port1_d0 (data1), port2_d0 (data2), port2_d1 (data4), port2_pp (data6), [port2_d3 (data5), port2_d4 (data7)]>. With the multitap port2_d3 and port2_d4 are port1_d1 and port1_pp of a second Multitap, with the fourscore port3_d0 and port4_d0 of a second Four Score.");
+
+/**
+ * @brief Definition of module parameter multitap_enabled. This parameter are readable and writable from the sysfs.
+ */
+module_param_cb(multitap, &snescon_adapter_ops, &snescon_config.pads_cfg.multitap_enabled, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(multitap, "Enable/disable multitap. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter fourscore_enabled. This parameter are readable and writable from the sysfs.
+ */
+module_param_cb(fourscore, &snescon_adapter_ops, &snescon_config.pads_cfg.fourscore_enabled, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(en_fourscore, "Enable/disable fourscore. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter lowcpu. This parameter are readable and writable from the sysfs.
+ */
+module_param_cb(lowcpu, &snescon_adapter_ops, &snescon_config.lowcpu, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(lowcpu, "Read the bus with timers between the clock edges instead of busy-waiting. Uses less CPU, a read takes longer. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter async_register. This parameter is readable from the sysfs.
+ */
+module_param_named(async_register, snescon_config.async_register, bool, S_IRUGO);
+MODULE_PARM_DESC(async_register, "Register the input devices in the background. modprobe only returns before they are registered if the module is also loaded with async_probe=1. A failure is then shown in the config file. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter mouse. This parameter are readable from the sysfs.
+ */
+module_param_named(mouse, snescon_config.pads_cfg.mouse_enabled, bool, S_IRUGO);
+MODULE_PARM_DESC(mouse, "Enable/disable SNES Mouse on port 1 and 2. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter mouse_speed. This parameter are readable and writable from the sysfs.
+ */
+module_param_named(mouse_speed, snescon_config.pads_cfg.mouse_speed, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mouse_speed, "Sensitivity of the SNES Mouse, 0 = slow, 1 = normal, 2 = fast. (Normal by default.)");
+
+/**
+ * @brief Definition of module parameter mouse_rate. This parameter are readable from the sysfs.
+ */
+module_param_named(mouse_rate, snescon_config.mouse_rate, uint, S_IRUGO);
+MODULE_PARM_DESC(mouse_rate, "Rate in Hz the bus is polled at while a SNES Mouse is connected, motion is accumulated between reports. (400 by default, 100 or less disables oversampling.)");
+
+/**
+ * @brief Definition of module parameter paddle. This parameter are readable from the sysfs.
+ */
+module_param_named(paddle, snescon_config.pads_cfg.paddle_enabled, bool, S_IRUGO);
+MODULE_PARM_DESC(paddle, "Enable/disable Arkanoid Vaus paddle on port 2, position on port2_d1 and button on port2_d3. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter zapper. This parameter are readable from the sysfs.
+ */
+module_param_named(zapper, snescon_config.pads_cfg.zapper_enabled, bool, S_IRUGO);
+MODULE_PARM_DESC(zapper, "Enable/disable NES Zapper on port 2, light sense on port2_d3 and trigger on port2_d4. (Disabled by default.)");
+
+/**
+ * @brief Definition of module parameter zapper_rate. This parameter are readable from the sysfs.
+ */
+module_param_named(zapper_rate, snescon_config.zapper_rate, uint, S_IRUGO);
+MODULE_PARM_DESC(zapper_rate, "Rate in Hz the Zapper light sense is sampled at after the trigger is pulled. (8000 by default, 100 or less disables it.)");
+
+/**
+ * Runtime suspend of the bus, the last device was closed a while ago. The pins are released to inputs.
+ *
+ * @param dev The device of the bus
+ * @return Status
+ */
+static int __maybe_unused snescon_runtime_suspend(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	pads_release_gpio(&cfg->pads_cfg);
+	return 0;
+}
+
+/**
+ * Runtime resume of the bus, a device is opened. The pins are set up again in one batched pass.
+ *
+ * @param dev The device of the bus
+ * @return Status
+ */
+static int __maybe_unused snescon_runtime_resume(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	pads_setup_gpio(&cfg->pads_cfg);
+	return 0;
+}
+
+/**
+ * System suspend. Polling is stopped before the pins are released, so the bus is not clocked while the system sleeps.
+ *
+ * @param dev The device of the bus
+ * @return Status
+ */
+static int __maybe_unused snescon_suspend(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	mutex_lock(&cfg->mutex);
+	cfg->suspended = true;
+	snescon_stop(cfg);
+	mutex_unlock(&cfg->mutex);
+
+	return pm_runtime_force_suspend(dev);
+}
+
+/**
+ * System resume. The pins are set up again if a device is open, and the bus is polled right away so the state of the
+ * pads is known without waiting a refresh period.
+ *
+ * @param dev The device of the bus
+ * @return Status
+ */
+static int __maybe_unused snescon_resume(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+	int status;
+
+	status = pm_runtime_force_resume(dev);
+
+	mutex_lock(&cfg->mutex);
+	cfg->suspended = false;
+	if (status == 0) {
+		snescon_start(cfg, true);
+	}
+	mutex_unlock(&cfg->mutex);
+
+	return status;
+}
+
+static const struct dev_pm_ops snescon_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(snescon_suspend, snescon_resume)
+	SET_RUNTIME_PM_OPS(snescon_runtime_suspend, snescon_runtime_resume, NULL)
+};
+
+/**
+ * Probe of the device of the bus. The pins were set up by init, so the device starts out active and is suspended
+ * once no device has been open for a while.
+ *
+ * @param pdev The device of the bus
+ * @return Status
+ */
+static int snescon_probe(struct platform_device *pdev) {
+	struct snescon_config *cfg = &snescon_config;
+
+	cfg->pdev = pdev;
+	platform_set_drvdata(pdev, cfg);
+
+	pm_runtime_set_active(&pdev->dev);
+	pm_runtime_set_autosuspend_delay(&pdev->dev, SUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&pdev->dev);
+	pm_runtime_enable(&pdev->dev);
+	pm_runtime_mark_last_busy(&pdev->dev);
+	pm_runtime_idle(&pdev->dev);
+	return 0;
+}
+
+/**
+ * Remove of the device of the bus. The pins are left to the exit function.
+ *
+ * @param pdev The device of the bus
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+static void snescon_remove(struct platform_device *pdev) {
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	pm_runtime_disable(&pdev->dev);
+}
+#else
+static int snescon_remove(struct platform_device *pdev) {
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	pm_runtime_disable(&pdev->dev);
+	return 0;
+}
+#endif
+
+static struct platform_driver snescon_driver = {
+	.probe = snescon_probe,
+	.remove = snescon_remove,
+	.driver = {
+		.name = PM_DEVICE_NAME,
+		.pm = &snescon_pm_ops,
+	},
+};
+
+/**
+ * Register the device of the bus and its driver, which handle suspend and resume.
+ *
+ * @param cfg The driver configuration
+ * @return Status
+ */
+static int snescon_pm_init(struct snescon_config *cfg) {
+	struct platform_device *pdev;
+	int status;
+
+	status = platform_driver_register(&snescon_driver);
+	if (status != 0) {
+		return status;
+	}
+
+	pdev = platform_device_register_simple(PM_DEVICE_NAME, -1, NULL, 0);
+	if (IS_ERR(pdev)) {
+		platform_driver_unregister(&snescon_driver);
+		return PTR_ERR(pdev);
+	}
+	if (!cfg->pdev) {
+		// Not bound to the driver.
+		platform_device_unregister(pdev);
+		platform_driver_unregister(&snescon_driver);
+		return -ENODEV;
+	}
+	return 0;
+}
+
+/**
+ * Unregister the device of the bus and its driver. The pins are left set up, as they were before power management.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_pm_exit(struct snescon_config *cfg) {
+	struct platform_device *pdev = cfg->pdev;
+
+	pm_runtime_get_sync(&pdev->dev);
+	platform_device_unregister(pdev);
+	platform_driver_unregister(&snescon_driver);
+	cfg->pdev = NULL;
+}
+
+/**
+ * Register the input devices, the bus is already set up. Runs from the init function, or asynchronously from it with
+ * async_register, in which case a failure leaves the driver loaded but unusable. It is reported in the config file
+ * and by every reconfiguration.
+ *
+ * @param data The pointer to the snescon_config structure
+ * @param cookie The async cookie
+ */
+static void snescon_register(void *data, async_cookie_t cookie) {
+	struct snescon_config *cfg = data;
+
+	cfg->register_status = pads_register(&cfg->pads_cfg);
+	if (cfg->register_status != 0) {
+		pr_err("Setup of input_device failed!\n");
+		return;
+	}
+
+	pr_info("Input devices registered %lld us after init\n", ktime_us_delta(ktime_get(), cfg->init_start));
+}
+
+/**
+ * Init function for the driver.
+ */
+static int __init snescon_init(void) {
+	struct snescon_settings settings;
+	unsigned int i;
+	int status = 0;
+
+	snescon_config.init_start = ktime_get();
+	
+	// Check if the supplied GPIO setting are useful.
+	snescon_settings_get(&snescon_config, &settings);
+	status = snescon_validate(&settings);
+	if (status != 0) {
+		return status;
+	}
+
+	// Fill in the gpio struct with bit values.
+	snescon_config.pads_cfg.n_gpios = snescon_config.gpio_id_cnt;
+	for (i = 0; i < snescon_config.gpio_id_cnt; ++i) {
+		snescon_config.pads_cfg.gpio[i] = gpio_get_bit(snescon_config.gpio_id[i]);
+	}
+
+	// Set up the gpio handler.
+	status = gpio_init(snescon_config.gpio_id, snescon_config.gpio_id_cnt);
+	if (status != 0) {
+		pr_err("Setup of the gpio handler failed\n");
+		return status;
+	}
+
+	status = pads_setup(&snescon_config.pads_cfg);
+	if (status != 0) {
+		pr_err("Setup of input_device failed!\n");
+
+		// Cleanup allocated resourses
+		gpio_exit();
+
+		return status;
+	}
+
+	// Initiate the mutex and the timer
+	mutex_init(&snescon_config.mutex);
+	mutex_init(&snescon_config.reconfig);
+	spin_lock_init(&snescon_config.capture.lock);
+	timer_setup(&snescon_config.timer, snescon_timer, 0);
+	hrtimer_setup(&snescon_config.sampler, snescon_sampler, CLOCK_MONOTONIC, SAMPLER_MODE);
+	hrtimer_setup(&snescon_config.zapper_sampler, snescon_zapper_sampler, CLOCK_MONOTONIC, SAMPLER_MODE);
+	hrtimer_setup(&snescon_config.bus_timer, snescon_bus, CLOCK_MONOTONIC, SAMPLER_MODE);
+	INIT_DELAYED_WORK(&snescon_config.detect, snescon_detect);
+
+	status = snescon_pm_init(&snescon_config);
+	if (status != 0) {
+		pr_err("Setup of power management failed\n");
+		pads_remove(&snescon_config.pads_cfg);
+		mutex_destroy(&snescon_config.mutex);
+		mutex_destroy(&snescon_config.reconfig);
+		gpio_exit();
+		return status;
+	}
+
+	snescon_debugfs_init(&snescon_config);
+
+	if (snescon_config.async_register) {
+		// The bus is live, the devices can be registered in the background.
+		async_schedule(snescon_register, &snescon_config);
+	} else {
+		snescon_register(&snescon_config, 0);
+		status = snescon_config.register_status;
+		if (status != 0) {
+			snescon_debugfs_exit(&snescon_config);
+			snescon_pm_exit(&snescon_config);
+			pads_remove(&snescon_config.pads_cfg);
+			mutex_destroy(&snescon_config.mutex);
+			mutex_destroy(&snescon_config.reconfig);
+			gpio_exit();
+			return status;
+		}
+	}
+
+	if (sysfs_create_file(&THIS_MODULE->mkobj.kobj, &config_attr.attr) != 0) {
+		pr_err("Could not create the config file, the driver can not be reconfigured\n");
+	}
+	snescon_config.live = true;
+	
+	pr_info("Loaded driver in %lld us\n", ktime_us_delta(ktime_get(), snescon_config.init_start));
+
+	return 0;
+}
+
+/**
+ * Exit function for the driver.
+ */
+static void __exit snescon_exit(void) {
+	sysfs_remove_file(&THIS_MODULE->mkobj.kobj, &config_attr.attr);
+	mutex_lock(&snescon_config.reconfig);
+	snescon_config.live = false;
+	mutex_unlock(&snescon_config.reconfig);
+
+	async_synchronize_full();
+	cancel_delayed_work_sync(&snescon_config.detect);
+	snescon_stop(&snescon_config);
+	snescon_debugfs_exit(&snescon_config);
+	// Removing the devices closes them, which drops the runtime PM reference.
+	pads_remove(&snescon_config.pads_cfg);
+	snescon_pm_exit(&snescon_config);
+	mutex_destroy(&snescon_config.mutex);
+	mutex_destroy(&snescon_config.reconfig);
+	gpio_exit();
+
+	pr_info("driver exit\n");
+}
+
+module_init (snescon_init);
+module_exit (snescon_exit);
@@ -32,6 +32,10 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/ioport.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/pm_runtime.h>
+#include <linux/version.h>
 #include <asm/io.h>
 
 /* _____ _____ _____ ____
@@ -43,6 +47,7 @@
  */
 
 static volatile unsigned *gpio;	// I/O access.
+static bool gpio_pull_2711;	// The pull-ups are set like on the BCM2711.
 
 // GPIO setup macros. Always use INP_GPIO(x) before using OUT_GPIO(x)
 #define INP_GPIO(g) *(gpio+((g)/10)) &= ~(7<<(((g)%10)*3))	// Set GPIO as input.
@@ -51,8 +56,25 @@ static volatile unsigned *gpio;	// I/O access.
 #define GPIO_SET *(gpio + 7)	// Sets bits which are 1 and ignores bits which are 0.
 #define GPIO_CLR *(gpio + 10)	// Clears bits which are 1 and ignores bits which are 0.
 
-#define BCM2836_PERI_BASE		0x3F000000
-#define GPIO_BASE               (BCM2836_PERI_BASE + 0x200000) // GPIO controller.
+#define GPIO_OFFSET 0x200000	// Offset of the GPIO controller from the peripheral base.
+#define GPIO_SIZE 0xF4
+#define GPIO_PUP_PDN_CNTRL 57	// Pull-up/down of the BCM2711, 2 bits per GPIO.
+
+/*
+ * Raspberry Pi SoCs and their peripheral base, most specific first. Detected from the device tree at runtime.
+ */
+static const struct {
+	const char *compatible;
+	unsigned long peri_base;
+} gpio_socs[] = {
+	{ "brcm,bcm2711", 0xFE000000 },
+	{ "brcm,bcm2837", 0x3F000000 },
+	{ "brcm,bcm2710", 0x3F000000 },
+	{ "brcm,bcm2836", 0x3F000000 },
+	{ "brcm,bcm2709", 0x3F000000 },
+	{ "brcm,bcm2835", 0x20000000 },
+	{ "brcm,bcm2708", 0x20000000 },
+};
 
 /*
  * All valid GPIOs found on the Raspberry Pi P1 Header.
@@ -78,21 +100,34 @@ static void gpio_clear(unsigned int g_bit) {
 }
 
 /**
- * Set GPIO as input
+ * Set GPIOs as input
  *
- * @param g_bit GPIO
+ * @param g_bit GPIOs
  */
 static void gpio_input(unsigned int g_bit) {
-	INP_GPIO(g_bit);
+	unsigned int g;
+
+	for (g = 0; g < 32; g++) {
+		if (g_bit & (1 << g)) {
+			INP_GPIO(g);
+		}
+	}
 }
 
 /**
- * Set GPIO as output.
+ * Set GPIOs as output.
  *
- * @param g_bit GPIO
+ * @param g_bit GPIOs
  */
 static void gpio_output(unsigned int g_bit) {
-	OUT_GPIO(g_bit);
+	unsigned int g;
+
+	for (g = 0; g < 32; g++) {
+		if (g_bit & (1 << g)) {
+			INP_GPIO(g);
+			OUT_GPIO(g);
+		}
+	}
 }
 
 /**
@@ -101,6 +136,19 @@ static void gpio_output(unsigned int g_bit) {
  * @param g_bit GPIO
  */
 static void gpio_enable_pull_up(unsigned int g_bit) {
+	unsigned int g, reg, shift;
+
+	if (gpio_pull_2711) {
+		for (g = 0; g < 32; g++) {
+			if (g_bit & (1 << g)) {
+				reg = GPIO_PUP_PDN_CNTRL + g / 16;
+				shift = (g % 16) * 2;
+				*(gpio + reg) = (*(gpio + reg) & ~(3 << shift)) | (1 << shift);
+			}
+		}
+		return;
+	}
+
 	*(gpio + 37) = 2;
 	udelay(10);
 	*(gpio + 38) = g_bit;
@@ -134,8 +182,21 @@ static unsigned int gpio_read_all(void) {
  * @return Result of the init operation
  */
 static int __init gpio_init(void) {
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(gpio_socs); i++) {
+		if (of_machine_is_compatible(gpio_socs[i].compatible)) {
+			break;
+		}
+	}
+	if (i == ARRAY_SIZE(gpio_socs)) {
+		pr_err("Unsupported SoC, the GPIO of the BCM2835, BCM2836, BCM2837 and BCM2711 are supported\n");
+		return -ENODEV;
+	}
+	gpio_pull_2711 = (i == 0);
+
 	// Set up gpio pointer for direct register access.
-	if ((gpio = ioremap(GPIO_BASE, 0xB0)) == NULL) {
+	if ((gpio = ioremap(gpio_socs[i].peri_base + GPIO_OFFSET, GPIO_SIZE)) == NULL) {
 		pr_err("io remap failed\n");
 		return -EBUSY;
 	}
@@ -334,10 +395,10 @@ static void pads_update(struct pads_config *cfg) {
 			input_sync(dev);
 		}
 
-		// Player 3 and 4
-		for (i = 2; i < 4; i++) {
-			dev = cfg->pad[i];
-			g = cfg->gpio[i];
+		// Player 3 and 4, shifted out after player 1 and 2 on the same port
+		for (i = 0; i < 2; i++) {
+			dev = cfg->pad[i + 2];
+			g = cfg->gpio[i + 2];
 
 			for (j = 0; j < 4; j++) {
 				input_report_key(dev, nes_btn_label[j], g & data[btn_index[j] + 8]);
@@ -363,7 +424,7 @@ static void pads_update(struct pads_config *cfg) {
 			g = cfg->gpio[i + 2];
 
 			// Check if current gamepad is of type SNES.
-			if((g & data[16]) == 1) {
+			if (g & data[16]) {
 
 				// SNES gamepad
 
@@ -403,29 +464,32 @@ static void pads_update(struct pads_config *cfg) {
 }
 
 /**
- * Setup all GPIOs.
+ * Setup all GPIOs. The pull-ups of all data pins are enabled with one sequence.
  * 
  * @param cfg Pads config
  */
-static void __init pads_setup_gpio(struct pads_config *cfg) {
-	int i, bit;
+static void pads_setup_gpio(struct pads_config *cfg) {
+	unsigned int data = 0;
+	int i;
 
 	// Setup GPIO for clk and latch
-	for(i = 0; i < 2; i++) {
-		bit = cfg->gpio[i];
-		gpio_output(bit);
-	}
+	gpio_output(cfg->gpio[0] | cfg->gpio[1]);
 
-	// Setup GPIO for port1_d0, port2_d0, port2_d1
+	// Setup GPIO for port1_d0, port2_d0, port2_d1 and port1_pp
 	for(i = 2; i < 5; i++) {
-		bit = cfg->gpio[i];
-		gpio_input(bit);
-		gpio_enable_pull_up(bit);
+		data |= cfg->gpio[i];
 	}
+	gpio_input(data | cfg->gpio[5]);
+	gpio_enable_pull_up(data);
+}
 
-	// Setup GPIO for port1_pp
-	bit = cfg->gpio[5];
-	gpio_input(bit);
+/**
+ * Release the GPIOs. The outputs are set back to inputs, so the bus is not driven.
+ *
+ * @param cfg Pads config
+ */
+static void pads_release_gpio(struct pads_config *cfg) {
+	gpio_input(cfg->gpio[0] | cfg->gpio[1]);
 }
 
 /**
@@ -490,12 +554,6 @@ static int __init pads_setup(struct pads_config *cfg) {
 		}
 	}	
 
-	if (status == 0) {
-		// Done with the input event handlers. 
-		// Setup the GPIO pins
-		pads_setup_gpio(cfg);
-	}
-
 	return status;
 }
 
@@ -521,6 +579,7 @@ static void __exit pads_remove(struct pads_config *cfg) {
  */
 
 #define REFRESH_TIME HZ/100
+#define SUSPEND_DELAY_MS 1000 // Time the pins stay set up after the last device was closed.
 
 MODULE_AUTHOR("Christian Isaksson");
 MODULE_AUTHOR("Karl Thoren <karl.h.thoren@gmail.com>");
@@ -528,6 +587,19 @@ MODULE_DESCRIPTION("NES, SNES, gamepad driver for Raspberry Pi");
 MODULE_LICENSE("GPL");
 MODULE_VERSION("1.0.0");
 
+// timer_setup came with 4.15.
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 15, 0)
+#error "The driver needs kernel 4.15 or newer"
+#endif
+
+// Timer functions that were renamed, the old names were removed in 6.15 and 6.16.
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
+#define timer_delete_sync del_timer_sync
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 16, 0)
+#define timer_container_of from_timer
+#endif
+
 /*
  * Structure that contain pads configuration, timer and mutex.
  */
@@ -536,6 +608,8 @@ struct snescon_config {
 	struct timer_list timer;
 	struct mutex mutex;
 	int snescon_usage_cnt;
+	bool suspended;	// Set while the system sleeps, the bus is not polled even if devices are open.
+	struct platform_device *pdev;	// Device the power management of the bus is bound to.
 	unsigned int gpio_id[MAX_NUMBER_OF_GPIOS];
 	unsigned int gpio_id_cnt; // Counter used in communication with userspace. Should be set to MAX_NUMBER_OF_GPIOS if parameter gpio_id is valid.
 };
@@ -543,17 +617,38 @@ struct snescon_config {
 /**
  * Timer that read and update all pads.
  * 
- * @param ptr The pointer to the snescon_config structure
+ * @param t The timer of the snescon_config structure
  */
-static void snescon_timer(unsigned long ptr) {
-	struct snescon_config* cfg = (void *) ptr;
+static void snescon_timer(struct timer_list *t) {
+	struct snescon_config *cfg = timer_container_of(cfg, t, timer);
 	pads_update(&(cfg->pads_cfg));
 	mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
 }
 
+/**
+ * Start polling the pads if a device is open, unless the system sleeps. Must be called with the mutex held.
+ *
+ * @param cfg The driver configuration
+ * @param now Poll right away, otherwise one refresh period from now
+ */
+static void snescon_start(struct snescon_config *cfg, bool now) {
+	if (cfg->snescon_usage_cnt <= 0 || cfg->suspended) {
+		return;
+	}
+
+	if (now) {
+		// The timer is stopped, it is armed again by the poll. Run it the way the timer would.
+		local_bh_disable();
+		snescon_timer(&cfg->timer);
+		local_bh_enable();
+	} else {
+		mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
+	}
+}
+
 /**
  * @brief Open function for the driver.
- * Enables the 
+ * Sets up the pins and starts the timer when the first device is opened.
  */
 static int snescon_open(struct input_dev* dev) {
 	struct snescon_config* cfg = input_get_drvdata(dev);
@@ -564,28 +659,40 @@ static int snescon_open(struct input_dev* dev) {
 		return status;
 	}
 
-	cfg->snescon_usage_cnt++;
-	if (cfg->snescon_usage_cnt > 0) {
-		// Atleast one device open. Start the timer or reset the timeout.
-		mod_timer(&cfg->timer, jiffies + REFRESH_TIME);
+	if (cfg->snescon_usage_cnt == 0) {
+		// First device opened. Set up the pins and start the timer.
+		status = pm_runtime_get_sync(&cfg->pdev->dev);
+		if (status < 0) {
+			pm_runtime_put_noidle(&cfg->pdev->dev);
+			pr_err("Could not resume the pads\n");
+			mutex_unlock(&cfg->mutex);
+			return status;
+		}
+		status = 0;
+		cfg->snescon_usage_cnt++;
+		snescon_start(cfg, false);
+	} else {
+		cfg->snescon_usage_cnt++;
 	}
 
 	mutex_unlock(&cfg->mutex);
-	return 0;
+	return status;
 }
 
 /**
  * @brief Close function for the driver.
- * Disables the timer if the last device are closed.
+ * Disables the timer if the last device are closed, the pins are released once it has stayed closed for a while.
  */
 static void snescon_close(struct input_dev* dev) {
 	struct snescon_config* cfg = input_get_drvdata(dev);
 
 	mutex_lock(&cfg->mutex);
 	cfg->snescon_usage_cnt--;
-	if (cfg->snescon_usage_cnt <= 0) {
+	if (cfg->snescon_usage_cnt == 0) {
 		// Last device closed. Disable the timer.
-		del_timer_sync(&cfg->timer);
+		timer_delete_sync(&cfg->timer);
+		pm_runtime_mark_last_busy(&cfg->pdev->dev);
+		pm_runtime_put_autosuspend(&cfg->pdev->dev);
 	}
 	mutex_unlock(&cfg->mutex);
 }
@@ -616,6 +723,165 @@ MODULE_PARM_DESC(gpio, "Mapping of the gpios for the driver are as follows: < cl
 module_param_named(fourscore, snescon_config.pads_cfg.fourscore_enabled, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(en_fourscore, "Enable/disable fourscore. (Disabled by default.)");
 
+/**
+ * Runtime suspend of the pads, the last device was closed a while ago. The pins are released to inputs.
+ *
+ * @param dev The device of the pads
+ * @return Status
+ */
+static int __maybe_unused snescon_runtime_suspend(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	pads_release_gpio(&cfg->pads_cfg);
+	return 0;
+}
+
+/**
+ * Runtime resume of the pads, a device is opened. The pins are set up again in one batched pass.
+ *
+ * @param dev The device of the pads
+ * @return Status
+ */
+static int __maybe_unused snescon_runtime_resume(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	pads_setup_gpio(&cfg->pads_cfg);
+	return 0;
+}
+
+/**
+ * System suspend. Polling is stopped before the pins are released.
+ *
+ * @param dev The device of the pads
+ * @return Status
+ */
+static int __maybe_unused snescon_suspend(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+
+	mutex_lock(&cfg->mutex);
+	cfg->suspended = true;
+	timer_delete_sync(&cfg->timer);
+	mutex_unlock(&cfg->mutex);
+
+	return pm_runtime_force_suspend(dev);
+}
+
+/**
+ * System resume. The pins are set up again if a device is open, and the pads are polled right away.
+ *
+ * @param dev The device of the pads
+ * @return Status
+ */
+static int __maybe_unused snescon_resume(struct device *dev) {
+	struct snescon_config *cfg = dev_get_drvdata(dev);
+	int status;
+
+	status = pm_runtime_force_resume(dev);
+
+	mutex_lock(&cfg->mutex);
+	cfg->suspended = false;
+	if (status == 0) {
+		snescon_start(cfg, true);
+	}
+	mutex_unlock(&cfg->mutex);
+
+	return status;
+}
+
+static const struct dev_pm_ops snescon_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(snescon_suspend, snescon_resume)
+	SET_RUNTIME_PM_OPS(snescon_runtime_suspend, snescon_runtime_resume, NULL)
+};
+
+/**
+ * Probe of the device of the pads. The pins are set up by init, so the device starts out active.
+ *
+ * @param pdev The device of the pads
+ * @return Status
+ */
+static int snescon_probe(struct platform_device *pdev) {
+	struct snescon_config *cfg = &snescon_config;
+
+	cfg->pdev = pdev;
+	platform_set_drvdata(pdev, cfg);
+
+	pm_runtime_set_active(&pdev->dev);
+	pm_runtime_set_autosuspend_delay(&pdev->dev, SUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&pdev->dev);
+	pm_runtime_enable(&pdev->dev);
+	pm_runtime_mark_last_busy(&pdev->dev);
+	pm_runtime_idle(&pdev->dev);
+	return 0;
+}
+
+/**
+ * Remove of the device of the pads.
+ *
+ * @param pdev The device of the pads
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+static void snescon_remove(struct platform_device *pdev) {
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	pm_runtime_disable(&pdev->dev);
+}
+#else
+static int snescon_remove(struct platform_device *pdev) {
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	pm_runtime_disable(&pdev->dev);
+	return 0;
+}
+#endif
+
+static struct platform_driver snescon_driver = {
+	.probe = snescon_probe,
+	.remove = snescon_remove,
+	.driver = {
+		.name = KBUILD_MODNAME,
+		.pm = &snescon_pm_ops,
+	},
+};
+
+/**
+ * Register the device of the pads and its driver, which handle suspend and resume.
+ *
+ * @param cfg The driver configuration
+ * @return Status
+ */
+static int __init snescon_pm_init(struct snescon_config *cfg) {
+	struct platform_device *pdev;
+	int status;
+
+	status = platform_driver_register(&snescon_driver);
+	if (status != 0) {
+		return status;
+	}
+
+	pdev = platform_device_register_simple(KBUILD_MODNAME, -1, NULL, 0);
+	if (IS_ERR(pdev)) {
+		platform_driver_unregister(&snescon_driver);
+		return PTR_ERR(pdev);
+	}
+	if (!cfg->pdev) {
+		// Not bound to the driver.
+		platform_device_unregister(pdev);
+		platform_driver_unregister(&snescon_driver);
+		return -ENODEV;
+	}
+	return 0;
+}
+
+/**
+ * Unregister the device of the pads and its driver. The pins are left set up, as they were before power management.
+ *
+ * @param cfg The driver configuration
+ */
+static void snescon_pm_exit(struct snescon_config *cfg) {
+	pm_runtime_get_sync(&cfg->pdev->dev);
+	platform_device_unregister(cfg->pdev);
+	platform_driver_unregister(&snescon_driver);
+	cfg->pdev = NULL;
+}
+
 /**
  * Init function for the driver.
  */
@@ -667,21 +933,32 @@ static int __init snescon_init(void) {
 		pr_err("Setup of the gpio handler failed\n");
 		return -EBUSY;
 	}
+	pads_setup_gpio(&snescon_config.pads_cfg);
+
+	// Initiate the mutex and the timer, the devices can be opened as soon as they are registered
+	mutex_init(&snescon_config.mutex);
+	timer_setup(&snescon_config.timer, snescon_timer, 0);
+
+	status = snescon_pm_init(&snescon_config);
+	if (status != 0) {
+		pr_err("Setup of power management failed\n");
+		mutex_destroy(&snescon_config.mutex);
+		gpio_exit();
+		return status;
+	}
 
 	status = pads_setup(&snescon_config.pads_cfg);
 	if (status != 0) {
 		pr_err("Setup of input_device failed!\n");
 
 		// Cleanup allocated resourses
+		snescon_pm_exit(&snescon_config);
+		mutex_destroy(&snescon_config.mutex);
 		gpio_exit();
 
 		return status;
 	}
 
-	// Initiate the mutex and the timer
-	mutex_init(&snescon_config.mutex);
-	setup_timer(&snescon_config.timer, snescon_timer, (long) &snescon_config);
-
 	pr_info("Loaded snescon\n");
 
 	return 0;
@@ -691,8 +968,10 @@ static int __init snescon_init(void) {
  * Exit function for the snescon.
  */
 static void __exit snescon_exit(void) {
-	del_timer(&snescon_config.timer);
+	timer_delete_sync(&snescon_config.timer);
+	// Removing the devices closes them, which drops the runtime PM reference.
 	pads_remove(&snescon_config.pads_cfg);
+	snescon_pm_exit(&snescon_config);
 	mutex_destroy(&snescon_config.mutex);
 	gpio_exit();
 
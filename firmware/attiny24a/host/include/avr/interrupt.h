@@ -0,0 +1,27 @@
+/*
+ * Host build of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+/*
+ * Interrupt vectors are plain functions, sim.c calls them when their interrupt is pending and enabled.
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H_
+#define SIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector) void vector(void)
+
+#define cli() (SREG &= ~(1 << SREG_I))
+#define sei() (SREG |= (1 << SREG_I))
+
+void PCINT0_vect(void);
+void TIM0_OVF_vect(void);
+void INT0_vect(void);
+void USI_START_vect(void);
+void USI_OVF_vect(void);
+
+#endif /* SIM_AVR_INTERRUPT_H_ */
@@ -0,0 +1,151 @@
+/*
+ * Host build of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+/*
+ * The registers and bits of the ATtiny24A that power_manager.c uses, named and numbered as in avr-libc's iotnx4.h.
+ * They are plain variables owned by sim.c, which reads them to drive the simulated pins, timer, ADC and interrupts.
+ * The pin registers can only be read through sim_pin(), so inputs follow the simulation. ADSC is cleared when a
+ * conversion is done, ADIF is never set.
+ */
+
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTA, DDRA, PORTB, DDRB;
+extern volatile uint8_t TCCR0B, TIMSK0, GIMSK, GIFR, PCMSK0, PCMSK1, MCUCR, ACSR, PRR, SREG;
+extern volatile uint8_t USICR, USISR, USIDR;
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB;
+extern volatile uint16_t ADC;
+
+uint8_t sim_pin(char port);
+
+#define PINA sim_pin('A')
+#define PINB sim_pin('B')
+
+#define _BV(bit) (1 << (bit))
+
+/* Port A */
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+
+/* Port B, PB3 is RESET */
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+
+/* TCCR0B */
+#define CS00 0
+#define CS01 1
+#define CS02 2
+
+/* TIMSK0 */
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+
+/* GIMSK */
+#define PCIE0 4
+#define PCIE1 5
+#define INT0 6
+
+/* GIFR */
+#define PCIF0 4
+#define PCIF1 5
+#define INTF0 6
+
+/* PCMSK0, port A */
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+
+/* PCMSK1, port B */
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+
+/* MCUCR */
+#define ISC00 0
+#define ISC01 1
+#define BODSE 2
+#define SM0 3
+#define SM1 4
+#define SE 5
+#define PUD 6
+#define BODS 7
+
+/* ACSR */
+#define ACD 7
+
+/* PRR */
+#define PRADC 0
+#define PRUSI 1
+#define PRTIM0 2
+#define PRTIM1 3
+
+/* ADMUX */
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define MUX4 4
+#define MUX5 5
+#define REFS0 6
+#define REFS1 7
+
+/* ADCSRA */
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+
+/* ADCSRB */
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+#define ADLAR 4
+#define ACME 6
+#define BIN 7
+
+/* SREG */
+#define SREG_I 7
+
+/* USICR */
+#define USITC 0
+#define USICLK 1
+#define USICS0 2
+#define USICS1 3
+#define USIWM0 4
+#define USIWM1 5
+#define USIOIE 6
+#define USISIE 7
+
+/* USISR */
+#define USICNT0 0
+#define USIDC 4
+#define USIPF 5
+#define USIOIF 6
+#define USISIF 7
+
+#endif /* SIM_AVR_IO_H_ */
@@ -0,0 +1,15 @@
+/*
+ * Host build of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+#ifndef SIM_AVR_POWER_H_
+#define SIM_AVR_POWER_H_
+
+#include <avr/io.h>
+
+#define power_adc_enable() (PRR &= ~(1 << PRADC))
+#define power_adc_disable() (PRR |= (1 << PRADC))
+
+#endif /* SIM_AVR_POWER_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Host build of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+/*
+ * The sleep modes and the macros work on MCUCR like avr-libc's for the ATtiny24A. sleep_cpu() advances the simulated
+ * time until an interrupt wakes the MCU, see sim.c, and clears BODS like the MCU does a few cycles after it was set.
+ */
+
+#ifndef SIM_AVR_SLEEP_H_
+#define SIM_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN _BV(SM1)
+#define SLEEP_MODE_STANDBY (_BV(SM1) | _BV(SM0))
+
+#define set_sleep_mode(mode) (MCUCR = (MCUCR & ~(_BV(SM1) | _BV(SM0))) | (mode))
+#define sleep_enable() (MCUCR |= _BV(SE))
+#define sleep_disable() (MCUCR &= ~_BV(SE))
+
+// BODS is set with BODSE, then alone, and only holds until the next sleep
+#define sleep_bod_disable() do { \
+	MCUCR |= _BV(BODS) | _BV(BODSE); \
+	MCUCR = (MCUCR & ~_BV(BODSE)) | _BV(BODS); \
+} while(0)
+
+void sleep_cpu(void);
+
+#define sleep_mode() do { \
+	sleep_enable(); \
+	sleep_cpu(); \
+	sleep_disable(); \
+} while(0)
+
+#endif /* SIM_AVR_SLEEP_H_ */
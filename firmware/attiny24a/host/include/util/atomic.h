@@ -0,0 +1,28 @@
+/*
+ * Host build of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+/*
+ * Only ATOMIC_RESTORESTATE, the interrupt flag is restored when the block is left.
+ */
+
+#ifndef SIM_UTIL_ATOMIC_H_
+#define SIM_UTIL_ATOMIC_H_
+
+#include <avr/io.h>
+
+#define ATOMIC_RESTORESTATE
+
+static inline uint8_t sim_atomic_begin(void) {
+	uint8_t sreg = SREG;
+
+	SREG &= ~(1 << SREG_I);
+	return sreg;
+}
+
+#define ATOMIC_BLOCK(type) \
+	for(uint8_t sim_sreg = sim_atomic_begin(), sim_once = 1; sim_once; sim_once = 0, SREG = sim_sreg)
+
+#endif /* SIM_UTIL_ATOMIC_H_ */
@@ -0,0 +1,581 @@
+/*
+ * Host simulation of the power manager firmware
+ *
+ *  Copyright (c) 2014 Christian Isaksson
+ */
+
+/*
+ * Runs power_manager.c on the host against the registers of include/. Only what the firmware uses is simulated: the
+ * pins, Timer0, INT0 on low level, the pin change interrupt of RPI_PIN, the sleep modes and the ADC, which
+ * samples the internal reference against a supply of SUPPLY_MV that a scenario can let sag. The USI is not
+ * simulated, the registers keep their defaults.
+ *
+ * Time is simulated. It stands still while the firmware runs, instead every wake up is counted as -w us awake. When
+ * the firmware sleeps it jumps to the next event: a Timer0 overflow, a scripted change of the power button or of
+ * RPI_PIN, or a step of the RPi. The RPi drives RPI_PIN high -b ms after it has been powered on and pulls it low -d ms
+ * after SHUTDOWN_PIN went high, when it has halted, like the gpio-poweroff overlay.
+ *
+ * Pins are sampled when the firmware goes to sleep, so an output is seen at the end of the wake up that changed it.
+ * Every scenario runs in its own process, the firmware starts from a reset.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include "power_manager.h"
+
+#define NEVER (~0ULL)
+#define NS_PER_MS 1000000ULL
+#define INTERVALS 4
+#define SUPPLY_MV 5000
+#define INT0_PIN PB2	// INT0 of the ATtiny24A, where the power button must be
+
+/*
+ * A time span of a scenario, in ms. Unused spans have length 0.
+ */
+struct interval {
+	unsigned int at;
+	unsigned int length;
+};
+
+struct scenario {
+	const char *name;
+	const char *description;
+	unsigned int length;				// ms
+	struct interval press[INTERVALS];	// The power button is held down
+	struct interval glitch[INTERVALS];	// RPI_PIN is pulled low while the RPi runs
+	boolean halts;						// The RPi halts when SHUTDOWN_PIN goes high
+	struct interval sag;				// The supply falls linearly to sagMv, and stays there
+	unsigned int sagMv;
+};
+
+static const struct scenario scenarios[] = {
+	{ "power_on", "the RPi is off, the power button is pressed",
+	  3000, { { 1000, 150 } }, { { 0 } }, true },
+	{ "soft_shutdown", "the RPi is on, the power button is pressed and the RPi halts",
+	  20000, { { 1000, 150 }, { 10000, 150 } }, { { 0 } }, true },
+	{ "hard_off", "the RPi is on and does not halt, the power button is held",
+	  16000, { { 1000, 150 }, { 10000, 3000 } }, { { 0 } }, false },
+	{ "rpi_glitch", "the RPi is on, RPI_PIN glitches low for 5, 50 and 90 ms",
+	  15000, { { 1000, 150 } }, { { 8000, 5 }, { 9000, 50 }, { 10000, 90 } }, true },
+	{ "undervoltage", "the RPi is on, the supply falls to 4500 mV in 5 s and the RPi halts",
+	  20000, { { 1000, 150 } }, { { 0 } }, true, { 8000, 5000 }, 4500 },
+	{ "standby", "the RPi is off, nothing happens",
+	  60000, { { 0 } }, { { 0 } }, true },
+};
+
+static const char *const reasons[] = { "none", "halted", "hard power off", "timeout", "undervoltage" };
+
+/* Registers */
+volatile uint8_t PORTA, DDRA, PORTB, DDRB;
+volatile uint8_t TCCR0B, TIMSK0, GIMSK, GIFR, PCMSK0, PCMSK1, MCUCR, ACSR, PRR, SREG;
+volatile uint8_t USICR, USISR, USIDR;
+volatile uint8_t ADMUX, ADCSRA, ADCSRB;
+volatile uint16_t ADC;
+
+/* Options */
+static unsigned long wakeUs = 100;	// Time the firmware is awake on every wake up
+static unsigned int bootMs = 3000;
+static unsigned int haltMs = 2500;
+static int verbose;
+
+/* Simulation */
+static const struct scenario *sc;
+static jmp_buf finished;
+static unsigned long long now;			// ns
+static unsigned long long timerPhase;	// ns since the last Timer0 overflow
+static boolean timerFlag;
+static unsigned long long adcDoneAt = NEVER;
+
+/* Pins and the RPi */
+static boolean buttonDown;
+static boolean powered;		// The MOSFET conducts
+static boolean running;		// The RPi has booted and not halted
+static boolean rpiLevel;
+static boolean shutdownLevel;
+static boolean ledLevel;
+static unsigned long long bootAt = NEVER;
+static unsigned long long haltAt = NEVER;
+
+/* Measurements, in ns, NEVER if it did not happen */
+static unsigned long long pressAt = NEVER;
+static unsigned long long requestAt = NEVER;
+static unsigned long long haltedAt = NEVER;
+static unsigned long long onLatency = NEVER;
+static unsigned long long offLatency = NEVER;
+static unsigned long long shutdownDuration = NEVER;
+static unsigned long long haltToOff = NEVER;
+static unsigned int unsafeCuts;
+static unsigned int requestMv;
+static unsigned int haltMv;
+static unsigned long wakeUps;
+static unsigned long long awakeNs;
+static unsigned long long idleNs;
+static unsigned long long powerDownNs;
+
+int firmware_main();
+
+static double ms(unsigned long long ns) {
+	return ns / (double)NS_PER_MS;
+}
+
+static void note(const char *what) {
+	if (verbose) {
+		printf("  %10.3f ms  %s\n", ms(now), what);
+	}
+}
+
+/*
+ * Time between two Timer0 overflows.
+ *
+ * @return ns, 0 if the timer is stopped
+ */
+static unsigned long long timerPeriod(void) {
+	static const unsigned int prescaler[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+	return prescaler[TCCR0B & 0x07] * 256ULL * 1000000000ULL / F_CPU;
+}
+
+/*
+ * Supply at the current time.
+ *
+ * @return mV
+ */
+static unsigned int supplyMv(void) {
+	unsigned long long start = sc->sag.at * NS_PER_MS;
+	unsigned long long length = sc->sag.length * NS_PER_MS;
+
+	if (!length || now < start) {
+		return SUPPLY_MV;
+	}
+	if (now >= start + length) {
+		return sc->sagMv;
+	}
+	return SUPPLY_MV - (SUPPLY_MV - sc->sagMv) * (now - start) / length;
+}
+
+/*
+ * Time of a conversion of the ADC, 13 ADC clocks.
+ *
+ * @return ns
+ */
+static unsigned long long adcConversion(void) {
+	unsigned int prescaler = 1 << (ADCSRA & 0x07);
+
+	return 13ULL * (prescaler < 2 ? 2 : prescaler) * 1000000000ULL / F_CPU;
+}
+
+static boolean within(const struct interval *span) {
+	int i;
+
+	for (i = 0; i < INTERVALS; i++) {
+		if (span[i].length && now >= span[i].at * NS_PER_MS && now < (span[i].at + span[i].length) * NS_PER_MS) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Find the next start or end of the time spans.
+ *
+ * @param span Time spans
+ * @param next Time of the next event so far
+ * @return Time of the next event
+ */
+static unsigned long long nextEdge(const struct interval *span, unsigned long long next) {
+	unsigned long long edge;
+	int i;
+
+	for (i = 0; i < INTERVALS; i++) {
+		if (!span[i].length) {
+			continue;
+		}
+		edge = span[i].at * NS_PER_MS;
+		if (edge > now && edge < next) {
+			next = edge;
+		}
+		edge += span[i].length * NS_PER_MS;
+		if (edge > now && edge < next) {
+			next = edge;
+		}
+	}
+	return next;
+}
+
+/*
+ * Read the levels of a port. Outputs read as driven, inputs that are not connected follow their pull-up.
+ *
+ * @param port 'A' or 'B'
+ * @return Levels of the pins
+ */
+uint8_t sim_pin(char port) {
+	uint8_t level;
+
+	if (port == 'A') {
+		// The I2C bus is idle
+		level = (uint8_t)~(1 << RPI_PIN);
+		if (rpiLevel) {
+			level |= 1 << RPI_PIN;
+		}
+		return (level & ~DDRA) | (PORTA & DDRA);
+	}
+
+	level = PORTB & ~(1 << PWRSW_PIN);
+	if (!buttonDown && (PORTB & (1 << PWRSW_PIN))) {
+		level |= 1 << PWRSW_PIN;
+	}
+	return (level & ~DDRB) | (PORTB & DDRB);
+}
+
+/*
+ * Update the pins and the RPi to the current time and take the measurements.
+ */
+static void update(void) {
+	char line[128];
+	boolean level;
+
+	level = within(sc->press);
+	if (level != buttonDown) {
+		buttonDown = level;
+		if (level) {
+			pressAt = now;
+		}
+		note(level ? "power button down" : "power button up");
+	}
+
+	// The P-channel MOSFET conducts while its gate is driven low
+	level = (DDRB & (1 << MOSFET_PIN)) && !(PORTB & (1 << MOSFET_PIN));
+	if (level != powered) {
+		powered = level;
+		if (powered) {
+			bootAt = now + bootMs * NS_PER_MS;
+			if (pressAt != NEVER) {
+				onLatency = now - pressAt;
+			}
+			note("MOSFET on");
+		} else {
+			if (pressAt != NEVER) {
+				offLatency = now - pressAt;
+			}
+			if (requestAt != NEVER) {
+				shutdownDuration = now - requestAt;
+			}
+			if (haltedAt != NEVER) {
+				haltToOff = now - haltedAt;
+			}
+			if (running || bootAt != NEVER) {
+				unsafeCuts++;
+			}
+			running = false;
+			bootAt = NEVER;
+			haltAt = NEVER;
+			snprintf(line, sizeof(line), "MOSFET off, reason %s", reasons[powerOffReason]);
+			note(line);
+		}
+	}
+
+	if (now >= bootAt) {
+		bootAt = NEVER;
+		running = true;
+		note("RPi booted");
+	}
+
+	level = (DDRA & PORTA & (1 << SHUTDOWN_PIN)) != 0;
+	if (level != shutdownLevel) {
+		shutdownLevel = level;
+		if (level) {
+			requestAt = now;
+			requestMv = supplyMv();
+			if (running && sc->halts && haltAt == NEVER) {
+				haltAt = now + haltMs * NS_PER_MS;
+			}
+		}
+		note(level ? "SHUTDOWN_PIN high" : "SHUTDOWN_PIN low");
+	}
+
+	if (now >= haltAt) {
+		haltAt = NEVER;
+		haltedAt = now;
+		haltMv = supplyMv();
+		running = false;
+		note("RPi halted");
+	}
+
+	level = (DDRB & PORTB & (1 << PWRLED_PIN)) != 0;
+	if (level != ledLevel) {
+		ledLevel = level;
+		note(level ? "LED on" : "LED off");
+	}
+
+	// Only the internal reference is sampled, against the supply
+	if ((ADCSRA & (1 << ADEN)) && (ADCSRA & (1 << ADSC)) && !(PRR & (1 << PRADC))) {
+		if (adcDoneAt == NEVER) {
+			adcDoneAt = now + adcConversion();
+		} else if (now >= adcDoneAt) {
+			adcDoneAt = NEVER;
+			if (ADMUX != ((1 << MUX5) | (1 << MUX0)) || (ADCSRB & ((1 << ADLAR) | (1 << BIN)))) {
+				fprintf(stderr, "%s: ADMUX 0x%02x, ADCSRB 0x%02x at %.3f ms, only the bandgap against Vcc is simulated\n",
+					sc->name, ADMUX, ADCSRB, ms(now));
+				exit(EXIT_FAILURE);
+			}
+			ADC = (BANDGAP_MV * 1024UL + supplyMv() / 2) / supplyMv();
+			if (ADC > 1023) {
+				ADC = 1023;
+			}
+			ADCSRA &= ~(1 << ADSC);
+		}
+	} else {
+		adcDoneAt = NEVER;
+	}
+
+	// RPI_PIN is low while the RPi is off, booting or halted
+	level = running && !within(sc->glitch);
+	if (level != rpiLevel) {
+		rpiLevel = level;
+		if (PCMSK0 & (1 << RPI_PIN)) {
+			GIFR |= 1 << PCIF0;
+		}
+		note(level ? "RPI_PIN high" : "RPI_PIN low");
+	}
+}
+
+/*
+ * Advance the time, Timer0 counts while the MCU is awake or idles.
+ *
+ * @param ns Time to advance
+ * @param spent Counter of the time spent in the current state
+ * @param clocked The clock of Timer0 runs
+ */
+static void advance(unsigned long long ns, unsigned long long *spent, boolean clocked) {
+	unsigned long long period = timerPeriod();
+
+	now += ns;
+	*spent += ns;
+	if (clocked && period) {
+		timerPhase += ns;
+		if (timerPhase >= period) {
+			timerPhase %= period;
+			timerFlag = true;
+		}
+	}
+}
+
+/*
+ * Run the interrupts that are pending and enabled, in the order of the vector table.
+ *
+ * @return TRUE if an interrupt ran
+ */
+static boolean dispatch(void) {
+	uint8_t sreg = SREG;
+	boolean ran = false;
+
+	// The global interrupt flag is cleared while an interrupt runs
+	SREG &= ~(1 << SREG_I);
+
+	// Only the low level trigger of INT0 is simulated
+	if ((GIMSK & (1 << INT0)) && !(MCUCR & ((1 << ISC01) | (1 << ISC00))) && !(sim_pin('B') & (1 << INT0_PIN))) {
+		INT0_vect();
+		ran = true;
+	}
+	if ((GIFR & (1 << PCIF0)) && (GIMSK & (1 << PCIE0))) {
+		GIFR &= ~(1 << PCIF0);
+		PCINT0_vect();
+		ran = true;
+	}
+	if (timerFlag && (TIMSK0 & (1 << TOIE0))) {
+		timerFlag = false;
+		TIM0_OVF_vect();
+		ran = true;
+	}
+
+	SREG = sreg;
+	return ran;
+}
+
+/*
+ * Account for the wake up that ends here and sleep until an interrupt has run. The scenario ends in here.
+ */
+void sleep_cpu(void) {
+	unsigned long long end = sc->length * NS_PER_MS;
+	unsigned long long next, period;
+	boolean powerDown = (MCUCR & ((1 << SM1) | (1 << SM0))) == SLEEP_MODE_PWR_DOWN;
+
+	wakeUps++;
+	advance(wakeUs * 1000ULL, &awakeNs, true);
+	if (!(MCUCR & (1 << SE))) {
+		return;
+	}
+	MCUCR &= ~(1 << BODS);
+	if (!(SREG & (1 << SREG_I))) {
+		fprintf(stderr, "%s: sleep with interrupts disabled at %.3f ms, the MCU never wakes up\n", sc->name, ms(now));
+		exit(EXIT_FAILURE);
+	}
+
+	while (1) {
+		update();
+		if (dispatch()) {
+			return;
+		}
+
+		next = nextEdge(sc->press, end);
+		next = nextEdge(sc->glitch, next);
+		if (bootAt < next) {
+			next = bootAt;
+		}
+		if (haltAt < next) {
+			next = haltAt;
+		}
+		if (adcDoneAt < next) {
+			next = adcDoneAt;
+		}
+		period = timerPeriod();
+		if (!powerDown && period && now + period - timerPhase < next) {
+			next = now + period - timerPhase;
+		}
+
+		if (next >= end) {
+			if (end > now) {
+				advance(end - now, powerDown ? &powerDownNs : &idleNs, !powerDown);
+			}
+			longjmp(finished, 1);
+		}
+		advance(next - now, powerDown ? &powerDownNs : &idleNs, !powerDown);
+	}
+}
+
+static void report(void) {
+	unsigned long long total = awakeNs + idleNs + powerDownNs;
+
+	if (onLatency != NEVER) {
+		printf("power on:  MOSFET on %.3f ms after the press\n", ms(onLatency));
+	}
+	if (offLatency != NEVER) {
+		printf("power off: MOSFET off %.3f ms after the press, reason %s\n", ms(offLatency),
+			reasons[powerOffReason]);
+	}
+	if (shutdownDuration != NEVER) {
+		printf("shutdown:  %.3f ms from SHUTDOWN_PIN high to MOSFET off", ms(shutdownDuration));
+		if (haltToOff != NEVER) {
+			printf(", %.3f ms after the halt", ms(haltToOff));
+		}
+		printf("\n");
+	}
+	if (sc->sag.length && requestAt != NEVER) {
+		printf("supply:    SHUTDOWN_PIN high at %u mV", requestMv);
+		if (sc->sagMv < SUPPLY_THRESHOLD) {
+			// The time the supply fell below the threshold
+			printf(", %.3f ms after it fell below %u mV", ms(requestAt) - sc->sag.at -
+				(double)sc->sag.length * (SUPPLY_MV - SUPPLY_THRESHOLD) / (SUPPLY_MV - sc->sagMv), SUPPLY_THRESHOLD);
+		}
+		if (haltedAt != NEVER) {
+			printf(", RPi halted at %u mV", haltMv);
+		}
+		printf("\n");
+	}
+	printf("cuts:      %u while the RPi was booting or running\n", unsafeCuts);
+	printf("sleep:     awake %.3f ms in %lu wake ups, idle %.3f ms, power-down %.3f ms, awake %.4f %% of the time\n",
+		ms(awakeNs), wakeUps, ms(idleNs), ms(powerDownNs), total ? 100.0 * awakeNs / total : 0.0);
+	printf("end:       RPi %s\n", !powered ? "off" : running ? "running" : "booting or halted");
+}
+
+/*
+ * Run a scenario in its own process.
+ *
+ * @param scenario The scenario
+ * @return 0 on success
+ */
+static int run(const struct scenario *scenario) {
+	int status;
+	pid_t pid;
+
+	printf("%s: %s\n", scenario->name, scenario->description);
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		sc = scenario;
+		if (!setjmp(finished)) {
+			firmware_main();
+		}
+		report();
+		exit(EXIT_SUCCESS);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		return -1;
+	}
+	printf("\n");
+	return 0;
+}
+
+static void usage(const char *name) {
+	unsigned int i;
+
+	fprintf(stderr,
+		"Usage: %s [-s scenario] [-w us] [-b ms] [-d ms] [-v]\n"
+		"  -s  Run one scenario, default all of them:", name);
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		fprintf(stderr, " %s", scenarios[i].name);
+	}
+	fprintf(stderr,
+		"\n"
+		"  -w  Time the firmware is awake on every wake up, default %lu us\n"
+		"  -b  Time until the RPi drives RPI_PIN high after power on, default %u ms\n"
+		"  -d  Time until the RPi halts after SHUTDOWN_PIN went high, default %u ms\n"
+		"  -v  Print the events of the scenarios\n", wakeUs, bootMs, haltMs);
+}
+
+int main(int argc, char *argv[]) {
+	const char *only = NULL;
+	unsigned int i;
+	int opt, failed = 0, found = 0;
+
+	while ((opt = getopt(argc, argv, "s:w:b:d:vh")) != -1) {
+		switch (opt) {
+		case 's':
+			only = optarg;
+			break;
+		case 'w':
+			wakeUs = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bootMs = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			haltMs = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("tick %lu us, awake %lu us per wake up, boot %u ms, halt %u ms\n\n", TICK_US, wakeUs, bootMs, haltMs);
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		if (only && strcmp(only, scenarios[i].name) != 0) {
+			continue;
+		}
+		found = 1;
+		if (run(&scenarios[i]) != 0) {
+			fprintf(stderr, "%s failed\n", scenarios[i].name);
+			failed = 1;
+		}
+	}
+	if (!found) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -3,90 +3,240 @@
  *
  * Copyright (c) 2014 Christian Isaksson
  */
-#define F_CPU 1200000UL
+#ifndef F_CPU
+#define F_CPU 1000000UL
+#endif
 
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/power.h>
 #include <avr/sleep.h>
-#include <util/delay.h>
-#include "powermanager.h"
+#include <util/atomic.h>
+#include "power_manager.h"
 
 ISR(PCINT0_vect) {
 	// Check which pin caused interrupt
 
 	// Check if RPI_PIN is low
-	if(!(PINB & _BV(RPI_PIN))) {
-		if(raspberryPi == shutdown)
+	if(!(PINA & _BV(RPI_PIN))) {
+		if(raspberryPi == shutdown) {
 			raspberryPi = poweroff;
+			shutdownTick = tick;
+		}
 	} else {
 		if(raspberryPi == on)
 			raspberryPi = shutdown;
+		// RPI_PIN glitched low, the RPi is still running
+		else if(raspberryPi == poweroff)
+			raspberryPi = shutdown;
 	}
 }
 
 ISR(TIM0_OVF_vect) {
 	tick++;
+	debouncePowerButton();
+	sampleSupply();
+}
+
+ISR(INT0_vect) {
+	// The power button went down, the next ticks confirm the press. INT0 is enabled again once it has been released
+	GIMSK &= ~(1 << INT0);
+	debounceCounter = 0;
+	powerButton = maybe_pressed;
+}
+
+ISR(USI_START_vect) {
+	usiState = check_address;
+	USI_DDR &= ~(1 << USI_SDA);
+
+	// Wait until the start condition has completed, SCL low, or a stop condition, SDA high
+	while((USI_PIN & (1 << USI_SCL)) && !(USI_PIN & (1 << USI_SDA)));
+
+	if(!(USI_PIN & (1 << USI_SDA))) {
+		// Start condition, hold SCL low when the counter overflows
+		USICR = (1 << USISIE) | (1 << USIOIE) | (1 << USIWM1) | (1 << USIWM0) | (1 << USICS1);
+	} else {
+		USICR = (1 << USISIE) | (1 << USIWM1) | (1 << USICS1);
+	}
+	// Clear flags and count the 8 bits of the address
+	USISR = (1 << USISIF) | (1 << USIOIF) | (1 << USIPF) | (1 << USIDC);
+}
+
+ISR(USI_OVF_vect) {
+	switch(usiState) {
+	case check_address:
+		if((USIDR >> 1) != I2C_ADDRESS) {
+			usiWaitForStart();
+			return;
+		}
+		if(USIDR & 0x01) {
+			usiState = send_data;
+		} else {
+			usiState = request_data;
+			registerPointerSet = false;
+		}
+		usiSendAck();
+		return;
+
+	case check_reply_from_send_data:
+		// NACK, the RPi does not want more data
+		if(USIDR) {
+			usiWaitForStart();
+			return;
+		}
+		// ACK, send the next register
+	case send_data:
+		USIDR = readRegister(registerPointer++);
+		usiState = request_reply_from_send_data;
+		usiSendData();
+		return;
+
+	case request_reply_from_send_data:
+		usiState = check_reply_from_send_data;
+		usiReadAck();
+		return;
+
+	case request_data:
+		usiState = get_data_and_send_ack;
+		usiReadData();
+		return;
+
+	case get_data_and_send_ack:
+		if(registerPointerSet) {
+			writeRegister(registerPointer++, USIDR);
+		} else {
+			registerPointer = USIDR;
+			registerPointerSet = true;
+		}
+		usiState = request_data;
+		usiSendAck();
+		return;
+	}
 }
 
 int main() {
+	boolean hardPowerOff = false;
+
 	/* Initialize global variables */
 	raspberryPi = off;
 	powerButtonCounter = 0;
+	debounceCounter = 0;
+	pressEvent = false;
+	longPressEvent = false;
 	tick = 0;
+	shutdownTick = 0;
+	shutdownRequestTick = 0;
+	powerOffReason = no_reason;
+	powerCycle = false;
+	powerCycleTick = 0;
+	supplyLow = false;
+	supplySampled = false;
+	lowSupplyEvent = false;
+
+	/* Registers */
+	registers[REG_PRESSED_DEBOUNCE] = PRESSED_DEBOUNCE;
+	registers[REG_RELEASED_DEBOUNCE] = RELEASED_DEBOUNCE;
+	registers[REG_HARD_POWER_OFF_DELAY] = HARD_POWER_OFF_DELAY & 0xFF;
+	registers[REG_HARD_POWER_OFF_DELAY + 1] = HARD_POWER_OFF_DELAY >> 8;
+	registers[REG_POWER_OFF_DELAY] = POWER_OFF_DELAY & 0xFF;
+	registers[REG_POWER_OFF_DELAY + 1] = POWER_OFF_DELAY >> 8;
+	registers[REG_SHUTDOWN_TIMEOUT] = SHUTDOWN_TIMEOUT & 0xFF;
+	registers[REG_SHUTDOWN_TIMEOUT + 1] = SHUTDOWN_TIMEOUT >> 8;
+	registers[REG_POWER_CYCLE_DELAY] = POWER_CYCLE_DELAY & 0xFF;
+	registers[REG_POWER_CYCLE_DELAY + 1] = POWER_CYCLE_DELAY >> 8;
+	registers[REG_ID] = I2C_ID;
+	registers[REG_SUPPLY_THRESHOLD] = SUPPLY_THRESHOLD & 0xFF;
+	registers[REG_SUPPLY_THRESHOLD + 1] = SUPPLY_THRESHOLD >> 8;
+	registersWritten = false;
+	applyRegisters();
 	powerButton = released;
 
+	/* Power reduction */
+	// The analog comparator is not used, the ADC only while the RPi is powered
+	ACSR |= (1 << ACD);
+	monitorSupply(false);
+
 	/* I/O pins */
 	// Set outputs
 	DDRB |= (1 << PWRLED_PIN);
-	DDRB |= (1 << SHUTDOWN_PIN);
+	DDRA |= (1 << SHUTDOWN_PIN);
 
 	// Activate internal pull up
 	PORTB |= (1 << PWRSW_PIN);
 
 	/* Timer0 Interrupt */
-	// Set timer prescaler to 1/64th the clock rate
+	// Set timer prescaler to 1/64th the clock rate, one tick every TICK_US
 	TCCR0B |= (1 << CS01) | (1 << CS00);
+	// Enable Timer0 overflow interrupt, the timer is stopped in power-down
+	TIMSK0 |= (1 << TOIE0);
 
 	/* Pin Change Interrupt */
-	// Enable PCINT0
-	PCMSK |= (1 << PCINT0);
-	GIMSK |= (1 << PCIE);
+	// Enable PCINT0, RPI_PIN is on port A
+	PCMSK0 |= (1 << PCINT0);
+	GIMSK |= (1 << PCIE0);
 
 	/* External Interrupt INT0 */
-	// Set INT0 to trigger on Falling Edge
-	MCUCR |= (1 << ISC01);
+	// Trigger INT0 on low level, edges can not wake the MCU from power-down
+	MCUCR &= ~((1 << ISC01) | (1 << ISC00));
 	// Enable external interrupt INT0
 	GIMSK |= (1 << INT0);
 
+	/* USI */
+	// I2C slave, the RPi polls the registers and sends commands
+	usiInit();
+
 	/* Global Interrupt */
 	// Enable global interrupt
 	SREG |= (1 << SREG_I);
 
 	while(1) {
-		if(powerButton == pressed) {
+		if(takeEvent(&pressEvent)) {
+			// A long press only powers off a RPi that was on when the button was pressed
+			hardPowerOff = raspberryPi != off;
 			if(raspberryPi == off) {
 				power(true);
-				waitUntilPowerButtonReleased(false);
 			} else {
-				// Invoke poweroff by setting SHUTDOWN_PIN high
-				PORTB |= (1 << SHUTDOWN_PIN);
-
-				if(waitUntilPowerButtonReleased(true)) {
-					power(false);
-					waitUntilPowerButtonReleased(false);
-				}
+				requestShutdown();
 			}
-			// Enable external interrupt INT0
-			GIMSK |= (1 << INT0);
 		}
-		_delay_ms(10);
+
+		if(takeEvent(&supplySampled))
+			updateSupply();
+
+		// Ask the RPi to shut down while the supply can still hold it up
+		if(takeEvent(&lowSupplyEvent) && raspberryPi != off) {
+			supplyLow = true;
+			requestShutdown();
+		}
+
+		if(takeEvent(&longPressEvent) && hardPowerOff) {
+			powerCycle = false;
+			powerOff(hard_power_off);
+		}
 
 		// Check if RPi power off criteria is fulfilled
-		if(raspberryPi == poweroff) {
-			_delay_ms(SHUTDOWN_DELAY);
-			power(false);
+		if(raspberryPi == poweroff && ticksSince(shutdownTick) >= powerOffTicks) {
+			powerOff(supplyLow ? undervoltage : halted);
+		}
+
+		// Safety net for a RPi that does not complete the requested shutdown
+		if((PORTA & (1 << SHUTDOWN_PIN)) && ticksSince(shutdownRequestTick) >= shutdownTimeoutTicks) {
+			powerOff(timeout);
+		}
+
+		// Registers written by the RPi are applied once the transfer has been stopped
+		if(registersWritten && (USISR & (1 << USIPF))) {
+			registersWritten = false;
+			applyRegisters();
+		}
+
+		// Power on the RPi again after a power cycle
+		if(raspberryPi == off && powerCycle && ticksSince(powerCycleTick) >= powerCycleTicks) {
+			powerCycle = false;
+			power(true);
 		}
-		_delay_ms(10);
+
+		sleepUntilInterrupt();
 	}
 	return 0;
 }
@@ -103,9 +253,11 @@ void power(boolean on) {
 		// Power on RPi
 		DDRB |= (1 << MOSFET_PIN);
 		raspberryPi = on;
+		supplyLow = false;
+		monitorSupply(true);
 	} else {
 		// Stop sending shutdown signal
-		PORTB &= ~(1 << SHUTDOWN_PIN);
+		PORTA &= ~(1 << SHUTDOWN_PIN);
 
 		// Turn off Power LED
 		PORTB &= ~(1 << PWRLED_PIN);
@@ -113,24 +265,285 @@ void power(boolean on) {
 		// Power off RPi
 		DDRB &= ~(1 << MOSFET_PIN);
 		raspberryPi = off;
+		monitorSupply(false);
 	}
 }
 
 /*
- * Perform debouncing on the power button and wait until it has been released
- * @param timeout Determines if function should check for hard power off or not
- * @return TRUE if timeout is TRUE and hard power off was detected, otherwise FALSE
+ * Power RPi off and remember why
+ * @param why Reason of the power off
  */
-boolean waitUntilPowerButtonReleased(boolean timeout) {
-	int counter = 0, timeoutCounter = 0;
+void powerOff(reason why) {
+	power(false);
+	powerOffReason = why;
+	if(powerCycle)
+		powerCycleTick = ticksSince(0);
+}
+
+/*
+ * Ask the RPi to shut down by setting SHUTDOWN_PIN high
+ */
+void requestShutdown(void) {
+	if(!(PORTA & (1 << SHUTDOWN_PIN)))
+		shutdownRequestTick = ticksSince(0);
+	PORTA |= (1 << SHUTDOWN_PIN);
+}
 
-	while(counter < RELEASED_DEBOUNCE_SAMPLES) {
-		counter = PINB & _BV(PWRSW_PIN) ? counter + 1 : 0;
-		if(timeout && ++timeoutCounter > HARD_POWER_OFF_DELAY) {
-			return true;
+/*
+ * Turn the supply monitoring on or off. The ADC is only powered while the RPi is, it is off in standby.
+ * @param enable TRUE = on, FALSE = off
+ */
+void monitorSupply(boolean enable) {
+	if(enable) {
+		power_adc_enable();
+		// The bandgap against Vcc, right adjusted and unipolar, ADC clock F_CPU / 8
+		ADMUX = SUPPLY_ADMUX;
+		ADCSRB = 0;
+		ADCSRA = (1 << ADEN) | (1 << ADPS1) | (1 << ADPS0);
+	} else {
+		ADCSRA = 0;
+		power_adc_disable();
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		supplyAdc = 0;
+		supplyConverting = false;
+		supplyDiscard = true;
+		supplySampleCounter = 0;
+		lowSupplyCounter = 0;
+	}
+	updateSupply();
+}
+
+/*
+ * Sample the supply every SUPPLY_SAMPLE_DELAY ms, called from the Timer0 tick. A conversion is started on one tick and
+ * read on a later one, the tick never waits for the ADC.
+ */
+void sampleSupply(void) {
+	if(!(ADCSRA & (1 << ADEN)))
+		return;
+
+	if(supplyConverting && !(ADCSRA & (1 << ADSC))) {
+		supplyConverting = false;
+		if(supplyDiscard) {
+			supplyDiscard = false;
+		} else {
+			supplyAdc = ADC;
+			supplySampled = true;
+			// A lower supply gives a higher sample of the reference
+			if(supplyThresholdAdc && supplyAdc > supplyThresholdAdc) {
+				if(lowSupplyCounter < SUPPLY_LOW_SAMPLES && ++lowSupplyCounter == SUPPLY_LOW_SAMPLES)
+					lowSupplyEvent = true;
+			} else {
+				lowSupplyCounter = 0;
+			}
 		}
-		_delay_ms(10);
 	}
-	powerButton = released;
-	return false;
+
+	if(!supplyConverting && ++supplySampleCounter >= MS_TO_TICKS(SUPPLY_SAMPLE_DELAY)) {
+		supplySampleCounter = 0;
+		supplyConverting = true;
+		ADCSRA |= (1 << ADSC);
+	}
+}
+
+/*
+ * Convert the last sample of the supply to mV for REG_SUPPLY
+ */
+void updateSupply(void) {
+	unsigned int sample, mv;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		sample = supplyAdc;
+	}
+	mv = sample ? BANDGAP_MV * 1024UL / sample : 0;
+
+	// REG_SUPPLY is read from the USI interrupt
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		registers[REG_SUPPLY] = mv & 0xFF;
+		registers[REG_SUPPLY + 1] = mv >> 8;
+	}
+}
+
+/*
+ * Debounce the power button and detect long presses, called from the Timer0 tick
+ */
+void debouncePowerButton(void) {
+	boolean down = !(PINB & _BV(PWRSW_PIN));
+
+	switch(powerButton) {
+	case maybe_pressed:
+		if(!down) {
+			// Glitch, wait for the next press
+			powerButton = released;
+			GIMSK |= (1 << INT0);
+		} else if(++debounceCounter >= pressedDebounceTicks) {
+			powerButton = pressed;
+			powerButtonCounter = 0;
+			pressEvent = true;
+		}
+		break;
+	case pressed:
+		if(!down) {
+			powerButton = maybe_released;
+			debounceCounter = 0;
+		}
+		break;
+	case maybe_released:
+		if(down) {
+			powerButton = pressed;
+		} else if(++debounceCounter >= releasedDebounceTicks) {
+			powerButton = released;
+			GIMSK |= (1 << INT0);
+		}
+		break;
+	default:
+		break;
+	}
+
+	// Time the press until it has been released
+	if((powerButton == pressed || powerButton == maybe_released) && powerButtonCounter < hardPowerOffTicks) {
+		if(++powerButtonCounter == hardPowerOffTicks)
+			longPressEvent = true;
+	}
+}
+
+/*
+ * Take an event raised by an interrupt
+ * @param event The event
+ * @return TRUE if the event was raised
+ */
+boolean takeEvent(volatile boolean *event) {
+	boolean raised;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		raised = *event;
+		*event = false;
+	}
+	return raised;
+}
+
+/*
+ * Get the number of ticks since a tick count was taken
+ * @param since Tick count
+ * @return Number of ticks
+ */
+unsigned int ticksSince(unsigned int since) {
+	unsigned int now;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		now = tick;
+	}
+	return now - since;
+}
+
+/*
+ * Sleep until an interrupt has been handled. The MCU is powered down while the RPi is off, the power button is
+ * released and no power cycle is pending, only the power button can wake it then. Otherwise it idles and is woken by the Timer0 tick and by the pin
+ * change interrupt.
+ */
+void sleepUntilInterrupt(void) {
+	// Interrupts are enabled by the instruction before sleep, an interrupt can not be missed in between
+	cli();
+	if(!pressEvent && !longPressEvent && !supplySampled && !lowSupplyEvent) {
+		// The button is debounced from the Timer0 tick, which is stopped in power-down
+		set_sleep_mode(raspberryPi == off && powerButton == released && !powerCycle ? SLEEP_MODE_PWR_DOWN : SLEEP_MODE_IDLE);
+		sleep_enable();
+#if defined(BODS) && defined(BODSE)
+		if(raspberryPi == off && powerButton == released && !powerCycle)
+			sleep_bod_disable();
+#endif
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+
+/*
+ * Get a 16 bit register
+ * @param reg Register of the low byte
+ * @return Value of the register
+ */
+unsigned int registerValue(unsigned char reg) {
+	return registers[reg] | (registers[reg + 1] << 8);
+}
+
+/*
+ * Apply the timing registers and the command written by the RPi
+ */
+void applyRegisters(void) {
+	unsigned int pressedDebounce, releasedDebounce, hardPowerOff, supplyThreshold;
+	unsigned char command;
+
+	pressedDebounce = MS_TO_TICKS(registers[REG_PRESSED_DEBOUNCE]);
+	releasedDebounce = MS_TO_TICKS(registers[REG_RELEASED_DEBOUNCE]);
+	hardPowerOff = MS_TO_TICKS(registerValue(REG_HARD_POWER_OFF_DELAY));
+	powerOffTicks = MS_TO_TICKS(registerValue(REG_POWER_OFF_DELAY));
+	shutdownTimeoutTicks = MS_TO_TICKS(registerValue(REG_SHUTDOWN_TIMEOUT));
+	powerCycleTicks = MS_TO_TICKS(registerValue(REG_POWER_CYCLE_DELAY));
+	// Below the internal reference the threshold can not be measured, the monitoring is disabled
+	supplyThreshold = registerValue(REG_SUPPLY_THRESHOLD);
+	supplyThreshold = supplyThreshold > BANDGAP_MV ? BANDGAP_MV * 1024UL / supplyThreshold : 0;
+
+	// The debounce timing is used from the Timer0 tick
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		pressedDebounceTicks = pressedDebounce;
+		releasedDebounceTicks = releasedDebounce;
+		hardPowerOffTicks = hardPowerOff;
+		supplyThresholdAdc = supplyThreshold;
+		command = registers[REG_COMMAND];
+		registers[REG_COMMAND] = COMMAND_NONE;
+	}
+
+	if(command == COMMAND_POWER_CYCLE)
+		powerCycle = true;
+	else if(command == COMMAND_CANCEL)
+		powerCycle = false;
+}
+
+/*
+ * Set up the USI as I2C slave, waiting for a start condition
+ */
+void usiInit(void) {
+	// SCL and SDA are open drain, pulled up by the RPi
+	USI_PORT |= (1 << USI_SCL) | (1 << USI_SDA);
+	USI_DDR |= (1 << USI_SCL);
+	USI_DDR &= ~(1 << USI_SDA);
+	usiWaitForStart();
+}
+
+/*
+ * Read a register for the RPi, called from the USI interrupt
+ * @param reg Register
+ * @return Content of the register
+ */
+unsigned char readRegister(unsigned char reg) {
+	switch(reg) {
+	case REG_STATE:
+		return raspberryPi | ((PORTA & (1 << SHUTDOWN_PIN)) ? STATE_SHUTDOWN_REQUESTED : 0) |
+			(supplyLow ? STATE_SUPPLY_LOW : 0);
+	case REG_REASON:
+		return powerOffReason;
+	case REG_SUPPLY:
+		// The main loop may update the register between the two bytes
+		supplyLatch = registers[REG_SUPPLY + 1];
+		return registers[REG_SUPPLY];
+	case REG_SUPPLY + 1:
+		return supplyLatch;
+	default:
+		return reg < REGISTERS ? registers[reg] : 0xFF;
+	}
+}
+
+/*
+ * Write a register for the RPi, called from the USI interrupt. Only the command, the timing and the threshold registers are writable.
+ * @param reg Register
+ * @param value Written value
+ */
+void writeRegister(unsigned char reg, unsigned char value) {
+	if((reg >= REG_COMMAND && reg < REG_ID) || reg == REG_SUPPLY_THRESHOLD || reg == REG_SUPPLY_THRESHOLD + 1) {
+		registers[reg] = value;
+		registersWritten = true;
+	}
 }
@@ -9,19 +9,108 @@
 
 /* I/O pins */
 
-#define RPI_PIN PB0			// Input, Detects if RPi has shutdown
-#define PWRSW_PIN PB1		// Input, Detects if power switch is ON or OFF
-#define PWRLED_PIN PB2		// Output, power indicator LED
-#define MOSFET_PIN PB3		// Output, Gate control to Power supply MOSFET
-#define SHUTDOWN_PIN PB4	// Output, signals the Raspberry to shutdown
+// ATtiny24A: PB3 is RESET, PA4 and PA6 are the USI
+#define RPI_PIN PA0			// Input, Detects if RPi has shutdown, PCINT0
+#define SHUTDOWN_PIN PA1	// Output, signals the Raspberry to shutdown
+#define PWRLED_PIN PB0		// Output, power indicator LED
+#define MOSFET_PIN PB1		// Output, Gate control to Power supply MOSFET
+#define PWRSW_PIN PB2		// Input, Detects if power switch is ON or OFF, INT0
 
-/* Delays */
-#define HARD_POWER_OFF_DELAY 200	// Time power button will need to be pressed until a hard power off is performed
-#define SHUTDOWN_DELAY 4000			// Time until power off RPi after RPI_PIN gone low
+/* Timer0 tick */
+#define TIMER0_PRESCALER 64
+#define TICK_US (TIMER0_PRESCALER * 256UL * 1000000UL / F_CPU)	// Time between two Timer0 overflows
+#define MS_TO_TICKS(ms) (((ms) * 1000UL + TICK_US - 1) / TICK_US)
 
-/* Values */
-#define PRESSED_DEBOUNCE_SAMPLES 10
-#define RELEASED_DEBOUNCE_SAMPLES 10
+/* Delays, in ms */
+#define HARD_POWER_OFF_DELAY 2000	// Time power button will need to be pressed until a hard power off is performed
+#define SHUTDOWN_DELAY 4000			// Time until power off RPi after RPI_PIN gone low, with HALT_DELAY
+#define HALT_SETTLE_DELAY 100		// Time RPI_PIN must stay low before power off RPi, with HALT_RPI_PIN
+#define SHUTDOWN_TIMEOUT 60000		// Time until power off RPi after a shutdown request that did not complete
+#define PRESSED_DEBOUNCE 10			// Time power button must be down for a press, rounded up to whole ticks
+#define RELEASED_DEBOUNCE 100		// Time power button must be up for a release
+
+/* Shutdown complete detection */
+#define HALT_DELAY 0		// RPI_PIN goes low when the RPi starts to shut down, it is assumed halted SHUTDOWN_DELAY later
+#define HALT_RPI_PIN 1		// RPI_PIN goes low when the RPi has halted, e.g. driven by the gpio-poweroff overlay
+#ifndef HALT_SIGNAL
+#define HALT_SIGNAL HALT_DELAY	// Build with -DHALT_SIGNAL=HALT_RPI_PIN when the RPi drops RPI_PIN once halted
+#endif
+
+#if HALT_SIGNAL == HALT_RPI_PIN
+#define POWER_OFF_DELAY HALT_SETTLE_DELAY
+#else
+#define POWER_OFF_DELAY SHUTDOWN_DELAY
+#endif
+
+/* Supply monitoring */
+#define SUPPLY_THRESHOLD 4750		// Supply below which the RPi is asked to shut down, in mV, 0 disables the monitoring
+#define SUPPLY_SAMPLE_DELAY 50		// Time between two samples of the supply, rounded up to whole ticks
+#define SUPPLY_LOW_SAMPLES 3		// Samples in a row below SUPPLY_THRESHOLD before the RPi is asked to shut down
+#define BANDGAP_MV 1100				// Internal reference, 1.0 to 1.2 V, calibrate it for an accurate threshold
+// ATtiny24A: REFS1:0 = 00 selects Vcc as reference, MUX5:0 = 100001 the 1.1 V bandgap as input
+#define SUPPLY_ADMUX ((0 << REFS1) | (0 << REFS0) | (1 << MUX5) | (1 << MUX0))
+
+/* I2C register interface */
+#define I2C_ADDRESS 0x24
+#define I2C_ID 0x50						// Content of REG_ID
+
+#define USI_DDR DDRA
+#define USI_PORT PORTA
+#define USI_PIN PINA
+#define USI_SCL PA4
+#define USI_SDA PA6
+
+// Release SDA and wait for the next start condition
+#define usiWaitForStart() do { \
+	USI_DDR &= ~(1 << USI_SDA); \
+	USICR = (1 << USISIE) | (1 << USIWM1) | (1 << USICS1); \
+	USISR = (1 << USIOIF) | (1 << USIPF) | (1 << USIDC); \
+} while(0)
+// Drive the ACK bit
+#define usiSendAck() do { \
+	USIDR = 0; \
+	USI_DDR |= (1 << USI_SDA); \
+	USISR = (1 << USIOIF) | (1 << USIPF) | (1 << USIDC) | (0x0E << USICNT0); \
+} while(0)
+// Sample the ACK bit of the RPi
+#define usiReadAck() do { \
+	USI_DDR &= ~(1 << USI_SDA); \
+	USIDR = 0; \
+	USISR = (1 << USIOIF) | (1 << USIPF) | (1 << USIDC) | (0x0E << USICNT0); \
+} while(0)
+// Shift out the 8 bits of USIDR
+#define usiSendData() do { \
+	USI_DDR |= (1 << USI_SDA); \
+	USISR = (1 << USIOIF) | (1 << USIPF) | (1 << USIDC); \
+} while(0)
+// Shift in 8 bits
+#define usiReadData() do { \
+	USI_DDR &= ~(1 << USI_SDA); \
+	USISR = (1 << USIOIF) | (1 << USIPF) | (1 << USIDC); \
+} while(0)
+
+#define REG_STATE 0x00					// Read, state of the RPi, STATE_SHUTDOWN_REQUESTED is set while SHUTDOWN_PIN is high
+#define REG_REASON 0x01					// Read, reason of the last power off
+#define REG_COMMAND 0x02				// Write, COMMAND_*
+#define REG_PRESSED_DEBOUNCE 0x03		// Read/write, ms
+#define REG_RELEASED_DEBOUNCE 0x04		// Read/write, ms
+#define REG_HARD_POWER_OFF_DELAY 0x05	// Read/write, ms, 16 bit little endian
+#define REG_POWER_OFF_DELAY 0x07		// Read/write, ms, 16 bit little endian
+#define REG_SHUTDOWN_TIMEOUT 0x09		// Read/write, ms, 16 bit little endian
+#define REG_POWER_CYCLE_DELAY 0x0B		// Read/write, ms, 16 bit little endian
+#define REG_ID 0x0D						// Read, I2C_ID
+#define REG_SUPPLY 0x0E					// Read, mV, 16 bit little endian, 0 while the RPi is off
+#define REG_SUPPLY_THRESHOLD 0x10		// Read/write, mV, 16 bit little endian
+#define REGISTERS 0x12
+
+#define STATE_SHUTDOWN_REQUESTED 0x80
+#define STATE_SUPPLY_LOW 0x40			// The RPi was asked to shut down on a low supply
+
+#define COMMAND_NONE 0x00
+#define COMMAND_POWER_CYCLE 0x01		// Power on the RPi again POWER_CYCLE_DELAY after it has halted
+#define COMMAND_CANCEL 0x02				// Cancel COMMAND_POWER_CYCLE
+
+#define POWER_CYCLE_DELAY 2000			// Time until power on RPi again after a power cycle was requested
 
 /* Type definitions */
 typedef enum {
@@ -39,25 +128,85 @@ typedef enum {
 typedef enum {
 	released = 0,
 	maybe_pressed,
-	pressed
+	pressed,
+	maybe_released
 } button;
 
 typedef enum {
-	low = 0,
-	high,
-	undefined
-} signal;
+	no_reason = 0,
+	halted,			// The RPi halted
+	hard_power_off,	// The power button was held
+	timeout,		// The RPi did not complete the requested shutdown
+	undervoltage	// The RPi halted after it was asked to shut down on a low supply
+} reason;
+
+typedef enum {
+	check_address = 0,
+	send_data,
+	request_reply_from_send_data,
+	check_reply_from_send_data,
+	request_data,
+	get_data_and_send_ack
+} usi;
 
 /* Global Variables */
 volatile device raspberryPi;
-volatile unsigned int powerButtonCounter;
+volatile unsigned int powerButtonCounter;	// Ticks the power button has been pressed
+volatile unsigned int debounceCounter;	// Ticks the power button has been in its maybe state
+volatile boolean pressEvent;	// Raised when a press has been debounced
+volatile boolean longPressEvent;	// Raised when the power button has been pressed for HARD_POWER_OFF_DELAY
 volatile unsigned long timerOverflowCounter;
 volatile button powerButton;
 volatile unsigned int tick;
+volatile unsigned int shutdownTick;	// Tick when RPI_PIN went low during shutdown
+volatile unsigned int shutdownRequestTick;	// Tick when SHUTDOWN_PIN was set high
+volatile reason powerOffReason;
+
+/* Timing, in ticks, set from the registers */
+volatile unsigned int pressedDebounceTicks;
+volatile unsigned int releasedDebounceTicks;
+volatile unsigned int hardPowerOffTicks;
+unsigned int powerOffTicks;
+unsigned int shutdownTimeoutTicks;
+unsigned int powerCycleTicks;
+boolean powerCycle;				// Power on the RPi again once it has been powered off
+unsigned int powerCycleTick;	// Tick when the RPi was powered off for the power cycle
+
+/* Supply monitoring */
+volatile unsigned int supplyAdc;		// Last sample, the internal reference against the supply
+volatile boolean supplySampled;		// Raised when supplyAdc has been sampled
+volatile boolean lowSupplyEvent;		// Raised when the supply has been below the threshold for SUPPLY_LOW_SAMPLES samples
+volatile boolean supplyConverting;	// A conversion was started on a tick, it is read on a later one
+volatile boolean supplyDiscard;		// The first conversion after the reference was selected is not accurate
+volatile unsigned char supplySampleCounter;	// Ticks since the last conversion was started
+volatile unsigned char lowSupplyCounter;	// Samples in a row below the threshold
+volatile unsigned int supplyThresholdAdc;	// SUPPLY_THRESHOLD as sample, set from the registers, 0 disables the monitoring
+volatile boolean supplyLow;			// The RPi was asked to shut down on a low supply
+
+/* I2C */
+volatile unsigned char registers[REGISTERS];
+volatile boolean registersWritten;	// Set when the RPi wrote a register, they are applied after the stop condition
+volatile usi usiState;
+volatile unsigned char registerPointer;
+volatile boolean registerPointerSet;	// The first byte written in a transfer sets registerPointer
+volatile unsigned char supplyLatch;	// High byte of REG_SUPPLY, latched when the low byte is read
 
 /* Function Prototypes */
 void power(boolean);
-boolean waitUntilPowerButtonReleased(boolean);
+void powerOff(reason);
+void requestShutdown(void);
+void monitorSupply(boolean);
+void sampleSupply(void);
+void updateSupply(void);
+void applyRegisters(void);
+unsigned int registerValue(unsigned char);
+void usiInit(void);
+unsigned char readRegister(unsigned char);
+void writeRegister(unsigned char, unsigned char);
+void debouncePowerButton(void);
+boolean takeEvent(volatile boolean *);
+unsigned int ticksSince(unsigned int);
+void sleepUntilInterrupt(void);
 
 
 #endif /* POWERMANAGER_H_ */